@@ -15,12 +15,33 @@ static struct password_scheme scheme_for(const char* const sitename) {
 
 	scheme.iterations = 10000;
 
+	/* Sponge rate in bits and size of each iteration's zero block in bytes.
+	 * passacre uses a rate of 64 and 1024-byte blocks; other rates must be
+	 * a multiple of 64 up to 1344, with 576, 832, 1024, 1088, 1152 and 1344
+	 * using specialised permutation entry points. A higher rate is faster,
+	 * but the capacity of 1600 minus the rate bits only gives half as many
+	 * bits of security: 128 at the highest rate of 1344. Zero (unset) means
+	 * passacre's values. */
+	scheme.rate = 64;
+	scheme.block_size = 1024;
+
+	/* Rounds of the Keccak permutation: 24 is Keccak-f[1600] as used by
+	 * passacre; 12 is Keccak-p[1600, 12] as used by TurboSHAKE, at twice
+	 * the speed. Zero (unset) means 24. */
+	scheme.rounds = 24;
+
 	/*
 	if (strcmp(sitename, "example") == 0) {
 		scheme.iterations += 5; // Equivalent of increment
 	} else if (strcmp(sitename, "foo") == 0) {
 		SCHEME_ADD(16, CS_ALPHANUMERIC)
 		return scheme;
+	} else if (strcmp(sitename, "bar") == 0) {
+		scheme.rate = 1088; // Not passacre-compatible
+		scheme.rounds = 12;
+		scheme.block_size = 4352;
+	} else if (strcmp(sitename, "baz") == 0) {
+		scheme.chains = 8; // 8 parallel chains (at most 256) of scheme.iterations each; not passacre-compatible
 	}
 	*/
 
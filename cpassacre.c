@@ -1,10 +1,31 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <termios.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__linux__)
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <time.h>
+#include <linux/futex.h>
+#endif
 #include "keccak/KeccakSponge.h"
+#include "keccak/KeccakHash.h"
 
 struct password_base {
 	struct password_base* next;
@@ -17,6 +38,59 @@ struct password_scheme {
 	size_t length;
 	int error;
 	unsigned int iterations;
+	unsigned int rate;
+	unsigned int rounds;
+	size_t block_size;
+	unsigned int chains;
+};
+
+struct derivation {
+	spongeState state;
+	struct password_scheme scheme;
+	char const* sitename;
+	char* identifier;
+	unsigned long long remaining_bits;
+};
+
+struct shard {
+	unsigned long index;
+	unsigned long count;
+	unsigned long sites;
+	KeccakHashState list_digest;
+	KeccakHashState checksum;
+};
+
+struct batch_password {
+	char const* sitename;
+	unsigned long line;
+	unsigned char output[1024];
+};
+
+/* Passwords squeezed in a batch run but not yet converted, which all share the same bases so that
+ * they can be converted together. */
+#define BATCH_PENDING 32
+
+struct batch {
+	struct shard* shard;
+	struct password_base* last_base;
+	size_t length;
+	size_t output_bytes;
+	unsigned int count;
+	struct batch_password passwords[BATCH_PENDING];
+};
+
+struct segment_record {
+	unsigned long line;
+	char const* sitename;
+	char const* password;
+};
+
+struct sponge_chain {
+	spongeState state;
+	struct password_scheme const* scheme;
+	unsigned int index;
+	int error;
+	unsigned char output[64];
 };
 
 __attribute__ ((warn_unused_result))
@@ -79,6 +153,76 @@ static char* password_read(char* const s, size_t const size) {
 
 #include "config.h"
 
+static struct {
+	char const* name;
+	char const* characters;
+} const character_sets[] = {
+	{"digit", CS_DIGIT},
+	{"lowercase", CS_LOWERCASE},
+	{"uppercase", CS_UPPERCASE},
+	{"symbols", CS_SYMBOLS},
+	{"letter", CS_LETTER},
+	{"alphanumeric", CS_ALPHANUMERIC},
+	{"printable", CS_PRINTABLE},
+};
+
+static void password_bases_free(struct password_base* last_base) {
+	while (last_base != NULL) {
+		struct password_base* const next = last_base->next;
+		free(last_base);
+		last_base = next;
+	}
+}
+
+/* Parses the bases of a scheme given as <count>:<character set>, joined by +
+ * (e.g. 1:uppercase+15:alphanumeric). */
+__attribute__ ((warn_unused_result))
+static int password_scheme_parse(struct password_scheme* const scheme, char const* spec) {
+	memset(scheme, 0, sizeof *scheme);
+
+	for (;;) {
+		char* end;
+		unsigned long const count = strtoul(spec, &end, 10);
+
+		if (end == spec || *end != ':' || count == 0) {
+			break;
+		}
+
+		spec = end + 1;
+
+		size_t const name_length = strcspn(spec, "+");
+		char const* character_set = NULL;
+
+		for (size_t i = 0; i < sizeof character_sets / sizeof *character_sets; i++) {
+			if (strlen(character_sets[i].name) == name_length && strncmp(character_sets[i].name, spec, name_length) == 0) {
+				character_set = character_sets[i].characters;
+				break;
+			}
+		}
+
+		if (character_set == NULL) {
+			break;
+		}
+
+		if (password_scheme_add(scheme, count, character_set) != 0) {
+			password_bases_free(scheme->last_base);
+			return 1;
+		}
+
+		spec += name_length;
+
+		if (*spec == '\0') {
+			return 0;
+		}
+
+		spec++;
+	}
+
+	fputs("Schemes must be of the form <count>:<character set>[+...], with a character set of digit, lowercase, uppercase, symbols, letter, alphanumeric or printable.\n", stderr);
+	password_bases_free(scheme->last_base);
+	return 1;
+}
+
 __attribute__ ((warn_unused_result))
 static size_t bytes_required_for(struct password_base const* last_base) {
 	float bytes = 0.0f;
@@ -92,13 +236,7 @@ static size_t bytes_required_for(struct password_base const* last_base) {
 }
 
 __attribute__ ((warn_unused_result))
-static unsigned char* upper_bound_for(struct password_base const* last_base, size_t const bytes_required) {
-	unsigned char* const result = malloc(bytes_required);
-
-	if (result == NULL) {
-		return NULL;
-	}
-
+static int upper_bound_for(struct password_base const* last_base, size_t const bytes_required, unsigned char* const result) {
 	memset(result, 0, bytes_required);
 	result[bytes_required - 1] = 1;
 
@@ -113,13 +251,13 @@ static unsigned char* upper_bound_for(struct password_base const* last_base, siz
 
 		if (carry != 0) {
 			fputs("Incorrect byte count. Something has gone terribly wrong.\n", stderr);
-			return NULL;
+			return 1;
 		}
 
 		last_base = last_base->next;
 	}
 
-	return result;
+	return 0;
 }
 
 __attribute__ ((warn_unused_result))
@@ -136,114 +274,2271 @@ static unsigned int long_divide(unsigned char* const bytes, unsigned int const d
 	return carry;
 }
 
-int main(int const argc, char const* const argv[]) {
-	if (argc != 2) {
-		fputs("Usage: cpassacre <site name>\n", stderr);
-		return EXIT_FAILURE;
+/* Absorbs the iterations' zero blocks. */
+__attribute__ ((warn_unused_result))
+static int absorb_iterations(spongeState* const state, struct password_scheme const* const scheme) {
+	unsigned long long const bits = (unsigned long long)scheme->iterations * scheme->block_size * 8;
+
+	return AbsorbZeroes(state, bits);
+}
+
+static void* sponge_chain_run(void* const arg) {
+	struct sponge_chain* const chain = arg;
+
+	/* A NUL can't occur in the site name, so it separates the chain index from it. */
+	unsigned char const separator[5] = {
+		0,
+		(unsigned char)chain->index,
+		(unsigned char)(chain->index >> 8),
+		(unsigned char)(chain->index >> 16),
+		(unsigned char)(chain->index >> 24),
+	};
+
+	chain->error =
+		Absorb(&chain->state, separator, sizeof separator * 8) != 0 ||
+		absorb_iterations(&chain->state, chain->scheme) != 0 ||
+		Squeeze(&chain->state, chain->output, sizeof chain->output * 8) != 0;
+
+	return NULL;
+}
+
+/* Runs each chain on its own thread, starting from a copy of the state with the password and
+ * site name absorbed, then replaces the state with a fresh sponge that has absorbed every chain's
+ * output in order. */
+__attribute__ ((warn_unused_result))
+static int absorb_chains(spongeState* const state, struct password_scheme const* const scheme) {
+	struct sponge_chain* const chains = malloc(scheme->chains * sizeof(struct sponge_chain));
+	pthread_t* const threads = malloc(scheme->chains * sizeof(pthread_t));
+
+	if (chains == NULL || threads == NULL) {
+		free(chains);
+		free(threads);
+		return 1;
 	}
 
-	char const* const sitename = argv[1];
+	int error = 0;
+	unsigned int started = 1;
 
-	struct password_scheme const scheme = scheme_for(sitename);
+	for (unsigned int i = 0; i < scheme->chains; i++) {
+		chains[i].state = *state;
+		chains[i].scheme = scheme;
+		chains[i].index = i;
+		chains[i].error = 0;
+	}
 
-	if (scheme.error) {
-		fputs("Failed to get scheme.\n", stderr);
-		return EXIT_FAILURE;
+	for (; started < scheme->chains; started++) {
+		if (pthread_create(&threads[started], NULL, sponge_chain_run, &chains[started]) != 0) {
+			error = 1;
+			break;
+		}
 	}
 
-	size_t const output_bytes_required = bytes_required_for(scheme.last_base);
+	if (!error) {
+		sponge_chain_run(&chains[0]);
+	}
 
-	if (output_bytes_required > 1024) {
-		fputs("The maximum password entropy is 8192 bits.\n", stderr);
-		return EXIT_FAILURE;
+	for (unsigned int i = 1; i < started; i++) {
+		pthread_join(threads[i], NULL);
 	}
 
-	spongeState state;
+	if (!error && InitSpongeRounds(state, scheme->rate, 1600 - scheme->rate, scheme->rounds) != 0) {
+		error = 1;
+	}
 
-	if (InitSponge(&state, 64, 1536) != 0) {
-		fputs("Failed to initialize sponge.\n", stderr);
-		return EXIT_FAILURE;
+	for (unsigned int i = 0; i < scheme->chains && !error; i++) {
+		error = chains[i].error || Absorb(state, chains[i].output, sizeof chains[i].output * 8) != 0;
 	}
 
-	unsigned char input[1024];
+	memset(chains, 0, scheme->chains * sizeof(struct sponge_chain));
+	free(chains);
+	free(threads);
 
-	if (password_read((char*)input, sizeof input) == NULL) {
-		if (!feof(stdin)) {
-			fputs("Failed to read password.\n", stderr);
-			return EXIT_FAILURE;
+	return error;
+}
+
+__attribute__ ((warn_unused_result))
+static int is_ascii(char const* const s, size_t const length) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 16 <= length; i += 16) {
+		if (_mm_movemask_epi8(_mm_loadu_si128((__m128i const*)(void const*)(s + i))) != 0) {
+			return 0;
 		}
+	}
+#else
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, s + i, sizeof word);
 
-		input[0] = '\0';
+		if ((word & 0x8080808080808080u) != 0) {
+			return 0;
+		}
 	}
+#endif
 
-	size_t input_length = strlen((char*)input);
+	for (; i < length; i++) {
+		if ((unsigned char)s[i] >= 0x80) {
+			return 0;
+		}
+	}
 
-	if (input[input_length - 1] == '\n') {
-		input_length--;
-	} else if (input_length > 1022) {
-		/* Avoid silent truncation at 1023 characters */
-		fputs("The maximum password length is 1022 characters.\n", stderr);
-		return EXIT_FAILURE;
+	return 1;
+}
+
+/* Decodes one UTF-8 sequence, returning its length or 0 if it's invalid. */
+__attribute__ ((warn_unused_result))
+static size_t utf8_decode(unsigned char const* const s, size_t const length, uint32_t* const code_point) {
+	static uint32_t const minimums[] = {0, 0, 0x80, 0x800, 0x10000};
+	size_t sequence_length;
+	uint32_t c = s[0];
+
+	if (c < 0x80) {
+		*code_point = c;
+		return 1;
+	} else if ((c & 0xe0) == 0xc0) {
+		sequence_length = 2;
+		c &= 0x1f;
+	} else if ((c & 0xf0) == 0xe0) {
+		sequence_length = 3;
+		c &= 0x0f;
+	} else if ((c & 0xf8) == 0xf0) {
+		sequence_length = 4;
+		c &= 0x07;
+	} else {
+		return 0;
 	}
 
-	input[input_length] = ':';
+	if (sequence_length > length) {
+		return 0;
+	}
 
-	if (Absorb(&state, input, (input_length + 1) * 8) != 0 ||
-			Absorb(&state, (unsigned char const*)sitename, strlen(sitename) * 8) != 0) {
-		fputs("Failed to absorb into sponge.\n", stderr);
-		return EXIT_FAILURE;
+	for (size_t i = 1; i < sequence_length; i++) {
+		if ((s[i] & 0xc0) != 0x80) {
+			return 0;
+		}
+
+		c = c << 6 | (s[i] & 0x3fu);
 	}
 
-	memset(input, 0, sizeof input);
+	if (c < minimums[sequence_length] || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+		return 0;
+	}
 
-	for (unsigned int i = 0; i < scheme.iterations; i++) {
-		if (Absorb(&state, input, sizeof input * 8) != 0) {
-			fputs("Failed to absorb into sponge.\n", stderr);
-			return EXIT_FAILURE;
+	*code_point = c;
+	return sequence_length;
+}
+
+/* Ranges of letters whose uppercase forms are at even offsets from the start, each followed by its
+ * lowercase form. */
+static uint32_t const alternating_cases[][2] = {
+	{0x100, 0x12f}, {0x132, 0x137}, {0x139, 0x148}, {0x14a, 0x177}, {0x179, 0x17e}, {0x1cd, 0x1dc},
+	{0x1de, 0x1ef}, {0x1f8, 0x21f}, {0x222, 0x233}, {0x3d8, 0x3ef}, {0x460, 0x481}, {0x48a, 0x4bf},
+	{0x4c1, 0x4ce}, {0x4d0, 0x4f5}, {0x4f8, 0x4f9}, {0x500, 0x50f}, {0x1e00, 0x1e95}, {0x1ea0, 0x1ef9}
+};
+
+/* The case mapping of Nameprep for Latin, Greek and Cyrillic letters. */
+__attribute__ ((warn_unused_result))
+static uint32_t code_point_lower(uint32_t const c) {
+	if ((c >= 'A' && c <= 'Z') || (c >= 0xc0 && c <= 0xde && c != 0xd7) || (c >= 0x391 && c <= 0x3ab && c != 0x3a2) || (c >= 0x410 && c <= 0x42f)) {
+		return c + 0x20;
+	}
+
+	if (c >= 0x400 && c <= 0x40f) {
+		return c + 0x50;
+	}
+
+	for (size_t i = 0; i < sizeof alternating_cases / sizeof *alternating_cases; i++) {
+		if (c >= alternating_cases[i][0] && c <= alternating_cases[i][1] && (c - alternating_cases[i][0]) % 2 == 0) {
+			return c + 1;
 		}
 	}
 
-	struct password_base* last_base = scheme.last_base;
+	if (c == 0x178) {
+		return 0xff;
+	}
 
-	{
-		unsigned char* const upper_bound = upper_bound_for(last_base, output_bytes_required);
+	if (c == 0x3c2) {
+		return 0x3c3;
+	}
 
-		if (upper_bound == NULL) {
-			fputs("Failed to allocate memory for upper bound.\n", stderr);
-			return EXIT_FAILURE;
+	return c;
+}
+
+/* Ranges containing every code point that Python's idna codec maps, normalizes, prohibits or checks
+ * for bidirectional text differently from identifier_normalize, generated by comparing it to the
+ * Unicode 3.2 Nameprep of encodings.idna one code point at a time. Combining marks, the second
+ * characters of canonical compositions and Hangul vowel and trailing jamo are included because
+ * normalization can join them to what precedes them. */
+static uint32_t const nameprep_unsupported[][2] = {
+	{0x80, 0xbe}, {0x132, 0x133}, {0x13f, 0x140}, {0x149, 0x149}, {0x17f, 0x17f}, {0x181, 0x182}, {0x184, 0x184},
+	{0x186, 0x187}, {0x189, 0x18b}, {0x18e, 0x191}, {0x193, 0x194}, {0x196, 0x198}, {0x19c, 0x19d}, {0x19f, 0x1a0},
+	{0x1a2, 0x1a2}, {0x1a4, 0x1a4}, {0x1a6, 0x1a7}, {0x1a9, 0x1a9}, {0x1ac, 0x1ac}, {0x1ae, 0x1af}, {0x1b1, 0x1b3},
+	{0x1b5, 0x1b5}, {0x1b7, 0x1b8}, {0x1bc, 0x1bc}, {0x1c4, 0x1cc}, {0x1f1, 0x1f4}, {0x1f6, 0x1f7}, {0x220, 0x220},
+	{0x23a, 0x24e}, {0x2b0, 0x2b8}, {0x2d8, 0x2e4}, {0x300, 0x38f}, {0x3cf, 0x3d6}, {0x3f0, 0x3f2}, {0x3f4, 0x3ff},
+	{0x483, 0x486}, {0x4c0, 0x4c0}, {0x4f6, 0x4f6}, {0x4fa, 0x4fe}, {0x510, 0x556}, {0x587, 0x655}, {0x66d, 0x6ed},
+	{0x6fa, 0x7b1}, {0x93c, 0x93c}, {0x94d, 0x94d}, {0x951, 0x95f}, {0x9bc, 0x9df}, {0xa33, 0xa33}, {0xa36, 0xa36},
+	{0xa3c, 0xa5b}, {0xa5e, 0xa5e}, {0xabc, 0xabc}, {0xacd, 0xacd}, {0xb3c, 0xb3c}, {0xb3e, 0xb5d}, {0xbbe, 0xbd7},
+	{0xc4d, 0xc56}, {0xcc2, 0xcd6}, {0xd3e, 0xd57}, {0xdca, 0xddf}, {0xe33, 0xe3a}, {0xe48, 0xe4b}, {0xeb3, 0xeb9},
+	{0xec8, 0xecb}, {0xedc, 0xedd}, {0xf0c, 0xf19}, {0xf35, 0xf39}, {0xf43, 0xf43}, {0xf4d, 0xf4d}, {0xf52, 0xf52},
+	{0xf57, 0xf57}, {0xf5c, 0xf5c}, {0xf69, 0xf69}, {0xf71, 0xf87}, {0xf93, 0xfc6}, {0x102e, 0x1039}, {0x10a0, 0x10cd},
+	{0x1161, 0x1175}, {0x11a8, 0x11c2}, {0x13a0, 0x13f5}, {0x1680, 0x1680}, {0x1714, 0x1714}, {0x1734, 0x1734}, {0x17d2, 0x17d2},
+	{0x1806, 0x180e}, {0x18a9, 0x1cbf}, {0x1e9a, 0x1e9e}, {0x1efa, 0x1efe}, {0x1f08, 0x1f0f}, {0x1f18, 0x1f1d}, {0x1f28, 0x1f2f},
+	{0x1f38, 0x1f3f}, {0x1f48, 0x1f4d}, {0x1f59, 0x1f5f}, {0x1f68, 0x1f6f}, {0x1f71, 0x1f71}, {0x1f73, 0x1f73}, {0x1f75, 0x1f75},
+	{0x1f77, 0x1f77}, {0x1f79, 0x1f79}, {0x1f7b, 0x1f7b}, {0x1f7d, 0x1faf}, {0x1fb2, 0x1fb4}, {0x1fb7, 0x1fc4}, {0x1fc7, 0x1fcf},
+	{0x1fd3, 0x1fd3}, {0x1fd8, 0x1fdf}, {0x1fe3, 0x1fe3}, {0x1fe8, 0x1ff4}, {0x1ff7, 0x217f}, {0x2183, 0x24ea}, {0x2a0c, 0x3000},
+	{0x302a, 0x302f}, {0x3036, 0x303a}, {0x3099, 0x309c}, {0x309f, 0x309f}, {0x30ff, 0x30ff}, {0x3131, 0x319f}, {0x3200, 0x33fe},
+	{0xa640, 0xa7f5}, {0xe000, 0xfa0d}, {0xfa10, 0xfa10}, {0xfa12, 0xfa12}, {0xfa15, 0xfa1e}, {0xfa20, 0xfa20}, {0xfa22, 0xfa22},
+	{0xfa25, 0xfa26}, {0xfa2a, 0xfeff}, {0xff5f, 0xffff}, {0x10400, 0x10427}, {0x104b0, 0x1ffff}, {0x2f800, 0x10ffff}
+};
+
+__attribute__ ((warn_unused_result))
+static int nameprep_supported(uint32_t const c) {
+	size_t low = 0;
+	size_t high = sizeof nameprep_unsupported / sizeof *nameprep_unsupported;
+
+	while (low != high) {
+		size_t const middle = low + (high - low) / 2;
+
+		if (c < nameprep_unsupported[middle][0]) {
+			high = middle;
+		} else if (c > nameprep_unsupported[middle][1]) {
+			low = middle + 1;
+		} else {
+			return 0;
 		}
+	}
 
-		do {
-			if (Squeeze(&state, input, output_bytes_required * 8) != 0) {
-				fputs("Failed to squeeze out of sponge.\n", stderr);
-				return EXIT_FAILURE;
+	return 1;
+}
+
+__attribute__ ((warn_unused_result))
+static unsigned int punycode_adapt(unsigned long delta, unsigned long const points, int const first) {
+	unsigned int k = 0;
+
+	delta = first ? delta / 700 : delta / 2;
+	delta += delta / points;
+
+	while (delta > (36 - 1) * 26 / 2) {
+		delta /= 36 - 1;
+		k += 36;
+	}
+
+	return k + (unsigned int)((36 - 1 + 1) * delta / (delta + 38));
+}
+
+static char punycode_digit(unsigned long const d) {
+	return (char)(d < 26 ? 'a' + d : '0' + (d - 26));
+}
+
+/* Encodes a label per RFC 3492, returning the end of the output. */
+static char* punycode_encode(uint32_t const* const label, size_t const length, char* out) {
+	size_t basic = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		if (label[i] < 0x80) {
+			*out++ = (char)label[i];
+			basic++;
+		}
+	}
+
+	if (basic != 0) {
+		*out++ = '-';
+	}
+
+	uint32_t n = 0x80;
+	unsigned long delta = 0;
+	unsigned int bias = 72;
+
+	for (size_t handled = basic; handled < length; delta++, n++) {
+		uint32_t m = UINT32_MAX;
+
+		for (size_t i = 0; i < length; i++) {
+			if (label[i] >= n && label[i] < m) {
+				m = label[i];
+			}
+		}
+
+		delta += (m - n) * (handled + 1);
+		n = m;
+
+		for (size_t i = 0; i < length; i++) {
+			if (label[i] < n) {
+				delta++;
+			} else if (label[i] == n) {
+				unsigned long q = delta;
+
+				for (unsigned int k = 36;; k += 36) {
+					unsigned int const t = k <= bias ? 1 : k >= bias + 26 ? 26 : k - bias;
+
+					if (q < t) {
+						break;
+					}
+
+					*out++ = punycode_digit(t + (q - t) % (36 - t));
+					q = (q - t) / (36 - t);
+				}
+
+				*out++ = punycode_digit(q);
+				bias = punycode_adapt(delta, handled + 1, handled == basic);
+				delta = 0;
+				handled++;
 			}
-		} while (memcmp(input, upper_bound, output_bytes_required) >= 0);
+		}
+	}
+
+	return out;
+}
+
+/* Converts a site name to the form passacre hashes, that of Python's idna codec: labels that are
+ * already ASCII are kept byte for byte, case included, and others are lowercased and encoded with
+ * Punycode unless that leaves them ASCII. Only the case mapping of Nameprep for Latin, Greek and
+ * Cyrillic letters (plus ß, İ and the fullwidth ASCII forms) is applied, and names containing code
+ * points that Nameprep would treat otherwise are rejected, to be converted by hand. The identifier
+ * is left NULL for names that are already ASCII. */
+__attribute__ ((warn_unused_result))
+static int identifier_normalize(char const* const sitename, char** const identifier) {
+	size_t const length = strlen(sitename);
+
+	*identifier = NULL;
 
-		free(upper_bound);
+	if (is_ascii(sitename, length)) {
+		return 0;
 	}
 
-	char* const result = malloc(scheme.length + 1);
+	uint32_t* const label = malloc(2 * length * sizeof(uint32_t));
+	char* const result = malloc(13 * length + 6);
 
-	if (result == NULL) {
+	if (label == NULL || result == NULL) {
+		free(label);
+		free(result);
 		fputs("Failed to allocate memory.\n", stderr);
-		return EXIT_FAILURE;
+		return 1;
 	}
 
-	char* current = result + scheme.length;
-	*current = '\0';
+	unsigned char const* s = (unsigned char const*)sitename;
+	unsigned char const* const end = s + length;
+	char* out = result;
 
-	while (last_base != NULL) {
-		unsigned int const c = long_divide(input, last_base->option_count, output_bytes_required);
-		*--current = last_base->options[c];
+	for (;;) {
+		unsigned char const* const label_start = s;
+		size_t label_length = 0;
+		int raw_ascii = 1;
+		int ascii = 1;
+		size_t separator_length = 0;
 
-		struct password_base* const next = last_base->next;
-		free(last_base);
-		last_base = next;
+		while (s != end) {
+			uint32_t c;
+			size_t const sequence_length = utf8_decode(s, (size_t)(end - s), &c);
+
+			if (sequence_length == 0) {
+				free(label);
+				free(result);
+				fputs("Site names must be valid UTF-8.\n", stderr);
+				return 1;
+			}
+
+			if (c == '.' || c == 0x3002 || c == 0xff0e || c == 0xff61) {
+				separator_length = sequence_length;
+				break;
+			}
+
+			if (!nameprep_supported(c)) {
+				free(label);
+				free(result);
+				fprintf(stderr, "Site names with U+%04lX need to be converted to Punycode by hand.\n", (unsigned long)c);
+				return 1;
+			}
+
+			s += sequence_length;
+			raw_ascii = raw_ascii && c < 0x80;
+
+			if (c >= 0xff01 && c <= 0xff5e) {
+				c -= 0xfee0;
+			}
+
+			if (c == 0xdf) {
+				label[label_length++] = 's';
+				c = 's';
+			} else if (c == 0x130) {
+				label[label_length++] = 'i';
+				c = 0x307;
+			} else {
+				c = code_point_lower(c);
+			}
+
+			label[label_length++] = c;
+			ascii = ascii && c < 0x80;
+		}
+
+		if (raw_ascii) {
+			memcpy(out, label_start, (size_t)(s - label_start));
+			out += s - label_start;
+		} else if (ascii) {
+			for (size_t i = 0; i < label_length; i++) {
+				*out++ = (char)label[i];
+			}
+		} else {
+			memcpy(out, "xn--", 4);
+			out = punycode_encode(label, label_length, out + 4);
+		}
+
+		if (separator_length == 0) {
+			break;
+		}
+
+		s += separator_length;
+		*out++ = '.';
 	}
 
-	puts(result);
+	*out = '\0';
+	free(label);
 
-	free(result);
+	*identifier = result;
+	return 0;
+}
+
+__attribute__ ((warn_unused_result))
+static int derivation_init(struct derivation* const derivation, char const* const sitename) {
+	derivation->sitename = sitename;
+	derivation->scheme = scheme_for(sitename);
+
+	if (identifier_normalize(sitename, &derivation->identifier) != 0) {
+		return 1;
+	}
+
+	if (derivation->scheme.error) {
+		fputs("Failed to get scheme.\n", stderr);
+		return 1;
+	}
+
+	if (bytes_required_for(derivation->scheme.last_base) > 1024) {
+		fputs("The maximum password entropy is 8192 bits.\n", stderr);
+		return 1;
+	}
+
+	/* Schemes from a config.h that predates these settings leave them zero;
+	 * they get passacre's values. */
+	if (derivation->scheme.rate == 0) {
+		derivation->scheme.rate = 64;
+	}
+
+	if (derivation->scheme.block_size == 0) {
+		derivation->scheme.block_size = 1024;
+	}
+
+	if (derivation->scheme.rounds == 0) {
+		derivation->scheme.rounds = 24;
+	}
+
+	/* The capacity left by the rate bounds the security of the sponge at half its size. */
+	if (derivation->scheme.rate > 1344) {
+		fputs("The rate cannot be more than 1344 bits, leaving at least 256 bits of capacity.\n", stderr);
+		return 1;
+	}
+
+	if (derivation->scheme.chains > 256) {
+		fputs("The number of chains cannot be more than 256.\n", stderr);
+		return 1;
+	}
+
+	struct password_scheme const* const scheme = &derivation->scheme;
+
+	if (InitSpongeRounds(&derivation->state, scheme->rate, 1600 - scheme->rate, scheme->rounds) != 0) {
+		fputs("Failed to initialize sponge.\n", stderr);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Absorbs the normalized site name into a state that has already absorbed the password. */
+__attribute__ ((warn_unused_result))
+static int derivation_absorb_site(struct derivation* const derivation) {
+	char const* const identifier = derivation->identifier != NULL ? derivation->identifier : derivation->sitename;
+
+	if (Absorb(&derivation->state, (unsigned char const*)identifier, strlen(identifier) * 8) != 0) {
+		fputs("Failed to absorb into sponge.\n", stderr);
+		return 1;
+	}
+
+	derivation->remaining_bits = (unsigned long long)derivation->scheme.iterations * derivation->scheme.block_size * 8;
+
+	return 0;
+}
+
+/* Absorbs the password, which must already be followed by a colon, and the normalized site name. */
+__attribute__ ((warn_unused_result))
+static int derivation_absorb(struct derivation* const derivation, unsigned char const* const password, size_t const password_length) {
+	if (Absorb(&derivation->state, password, password_length * 8) != 0) {
+		fputs("Failed to absorb into sponge.\n", stderr);
+		return 1;
+	}
+
+	return derivation_absorb_site(derivation);
+}
+
+/* Runs the derivation's iterations, on the sponge chains if the scheme has them. */
+__attribute__ ((warn_unused_result))
+static int derivation_iterate(struct derivation* const derivation) {
+	if (derivation->scheme.chains > 1) {
+		if (absorb_chains(&derivation->state, &derivation->scheme) != 0) {
+			fputs("Failed to run sponge chains.\n", stderr);
+			return 1;
+		}
+	} else if (absorb_iterations(&derivation->state, &derivation->scheme) != 0) {
+		fputs("Failed to absorb into sponge.\n", stderr);
+		return 1;
+	}
+
+	derivation->remaining_bits = 0;
+	return 0;
+}
+
+/* Runs the derivation's remaining iterations for at most max_permutations permutations, so a host
+ * can interleave a derivation with other work; the iterations are done when remaining_bits is
+ * zero. Chains run on their own threads and can't be stepped. */
+__attribute__ ((warn_unused_result))
+static int derivation_step(struct derivation* const derivation, unsigned long long const max_permutations) {
+	unsigned long long const rate = derivation->state.rate;
+	unsigned long long bits = derivation->remaining_bits;
+
+	if (derivation->scheme.chains > 1) {
+		fputs("Derivations with chains can't be stepped.\n", stderr);
+		return 1;
+	}
+
+	if (max_permutations == 0) {
+		return 0;
+	}
+
+	/* Absorbing a bit that fills the block costs a permutation. */
+	if (max_permutations <= bits / rate) {
+		bits = max_permutations * rate - derivation->state.bitsInQueue;
+	}
+
+	if (bits != 0 && AbsorbZeroes(&derivation->state, bits) != 0) {
+		fputs("Failed to absorb into sponge.\n", stderr);
+		return 1;
+	}
+
+	derivation->remaining_bits -= bits;
+	return 0;
+}
+
+/* Squeezes the first output below the upper bound of the scheme's bases, so that converting it
+ * picks every password with the same probability. */
+__attribute__ ((warn_unused_result))
+static int derivation_squeeze(struct derivation* const derivation, unsigned char* const output, size_t const output_bytes_required) {
+	unsigned char upper_bound[1024];
+
+	if (upper_bound_for(derivation->scheme.last_base, output_bytes_required, upper_bound) != 0) {
+		return 1;
+	}
+
+	do {
+		if (Squeeze(&derivation->state, output, output_bytes_required * 8) != 0) {
+			fputs("Failed to squeeze out of sponge.\n", stderr);
+			return 1;
+		}
+	} while (memcmp(output, upper_bound, output_bytes_required) >= 0);
+
+	return 0;
+}
+
+/* Converts a squeezed output to a password of the given length, one base at a time from its
+ * last character. */
+static void password_convert(struct password_base const* const last_base, unsigned char* const output, size_t const byte_count, char* const result, size_t const length) {
+	char* current = result + length;
+	*current = '\0';
+
+	for (struct password_base const* base = last_base; base != NULL; base = base->next) {
+		unsigned int const c = long_divide(output, base->option_count, byte_count);
+		*--current = base->options[c];
+	}
+}
+
+#if defined(__AVX2__)
+typedef __m256i convert_vector;
+#define CONVERT_LANES 16
+#define convert_load(p) _mm256_loadu_si256((__m256i const*)(p))
+#define convert_store(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+#define convert_set1(x) _mm256_set1_epi16((short)(x))
+#define convert_or(x, y) _mm256_or_si256(x, y)
+#define convert_add(x, y) _mm256_add_epi16(x, y)
+#define convert_sub(x, y) _mm256_sub_epi16(x, y)
+#define convert_mullo(x, y) _mm256_mullo_epi16(x, y)
+#define convert_mulhi(x, y) _mm256_mulhi_epu16(x, y)
+#define convert_shift_left_byte(x) _mm256_slli_epi16(x, 8)
+#define convert_shift_right(x, count) _mm256_srl_epi16(x, count)
+#elif defined(__SSE2__)
+typedef __m128i convert_vector;
+#define CONVERT_LANES 8
+#define convert_load(p) _mm_loadu_si128((__m128i const*)(p))
+#define convert_store(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define convert_set1(x) _mm_set1_epi16((short)(x))
+#define convert_or(x, y) _mm_or_si128(x, y)
+#define convert_add(x, y) _mm_add_epi16(x, y)
+#define convert_sub(x, y) _mm_sub_epi16(x, y)
+#define convert_mullo(x, y) _mm_mullo_epi16(x, y)
+#define convert_mulhi(x, y) _mm_mulhi_epu16(x, y)
+#define convert_shift_left_byte(x) _mm_slli_epi16(x, 8)
+#define convert_shift_right(x, count) _mm_srl_epi16(x, count)
+#endif
+
+/* Converts squeezed outputs of the same size under the same bases, as password_convert does for
+ * each. password_scheme_add limits bases to 256 options, so every step of the long division divides
+ * a 16-bit number. The outputs are laid out side by side in 16-bit lanes and divided together by
+ * multiplying with the divisor's reciprocal (Granlund and Montgomery, "Division by Invariant
+ * Integers using Multiplication", figure 4.1). */
+static void passwords_convert(struct password_base const* const last_base, unsigned char* const outputs[], unsigned int const count, size_t const byte_count, char* const results[], size_t const length) {
+#if defined(CONVERT_LANES)
+	for (unsigned int first = 0; first < count; first += CONVERT_LANES) {
+		unsigned int const lanes = count - first < CONVERT_LANES ? count - first : CONVERT_LANES;
+		convert_vector digits[1024];
+		uint16_t lane_values[CONVERT_LANES];
+
+		for (size_t i = 0; i < byte_count; i++) {
+			memset(lane_values, 0, sizeof lane_values);
+
+			for (unsigned int j = 0; j < lanes; j++) {
+				lane_values[j] = outputs[first + j][i];
+			}
+
+			digits[i] = convert_load(lane_values);
+		}
+
+		size_t position = length;
+
+		for (struct password_base const* base = last_base; base != NULL; base = base->next) {
+			unsigned int const divisor = base->option_count;
+			unsigned int log = 0;
+
+			while ((1u << log) < divisor) {
+				log++;
+			}
+
+			convert_vector const multiplier = convert_set1((65536u * ((1u << log) - divisor)) / divisor + 1);
+			convert_vector const divisor_vector = convert_set1(divisor);
+			__m128i const shift1 = _mm_cvtsi32_si128(log < 1 ? (int)log : 1);
+			__m128i const shift2 = _mm_cvtsi32_si128(log < 1 ? 0 : (int)log - 1);
+			convert_vector carry = convert_set1(0);
+
+			for (size_t i = 0; i < byte_count; i++) {
+				convert_vector const n = convert_or(convert_shift_left_byte(carry), digits[i]);
+				convert_vector const t = convert_mulhi(n, multiplier);
+				convert_vector const q = convert_shift_right(convert_add(t, convert_shift_right(convert_sub(n, t), shift1)), shift2);
+
+				carry = convert_sub(n, convert_mullo(q, divisor_vector));
+				digits[i] = q;
+			}
+
+			convert_store(lane_values, carry);
+			position--;
+
+			for (unsigned int j = 0; j < lanes; j++) {
+				results[first + j][position] = base->options[lane_values[j]];
+			}
+		}
+
+		for (unsigned int j = 0; j < lanes; j++) {
+			results[first + j][length] = '\0';
+		}
+
+		memset(digits, 0, byte_count * sizeof *digits);
+		memset(lane_values, 0, sizeof lane_values);
+	}
+#else
+	for (unsigned int j = 0; j < count; j++) {
+		password_convert(last_base, outputs[j], byte_count, results[j], length);
+	}
+#endif
+}
+
+/* Squeezes and converts the password into a result of the given size. */
+__attribute__ ((warn_unused_result))
+static int derivation_render_into(struct derivation* const derivation, char* const result, size_t const result_size) {
+	size_t const output_bytes_required = bytes_required_for(derivation->scheme.last_base);
+	unsigned char output[1024];
+
+	if (output_bytes_required == 0 || output_bytes_required > sizeof output) {
+		fputs("A password must have between 1 and 8192 bits of entropy.\n", stderr);
+		return 1;
+	}
+
+	if (derivation->scheme.length >= result_size) {
+		fputs("The password is too long.\n", stderr);
+		return 1;
+	}
+
+	if (derivation_squeeze(derivation, output, output_bytes_required) != 0) {
+		return 1;
+	}
+
+	password_convert(derivation->scheme.last_base, output, output_bytes_required, result, derivation->scheme.length);
+	memset(output, 0, sizeof output);
+
+	return 0;
+}
+
+/* Squeezes and converts the password into a new string, freeing the scheme's bases. */
+__attribute__ ((warn_unused_result))
+static char* derivation_render(struct derivation* const derivation) {
+	char* const result = malloc(derivation->scheme.length + 1);
+
+	if (result == NULL) {
+		fputs("Failed to allocate memory.\n", stderr);
+		return NULL;
+	}
+
+	if (derivation_render_into(derivation, result, derivation->scheme.length + 1) != 0) {
+		free(result);
+		return NULL;
+	}
+
+	password_bases_free(derivation->scheme.last_base);
+	derivation->scheme.last_base = NULL;
+
+	return result;
+}
+
+/* A checkpoint holds what's needed to resume a derivation: a magic number and format version, the
+ * scheme's iterations and block size, the zero bits left to absorb, the saved sponge and the site
+ * name, with integers little-endian. It lets anyone finish the derivation without the password. */
+static unsigned char const checkpoint_magic[4] = {'c', 'p', 'c', 'k'};
+
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_HEADER_SIZE (sizeof checkpoint_magic + 1 + 4 + 8 + 8 + KeccakSpongeSavedSize + 2)
+
+/* Permutations run between checkpoints. */
+#define CHECKPOINT_PERMUTATIONS 262144
+
+static void store_le(unsigned char* const bytes, uint64_t const value, size_t const byte_count) {
+	for (size_t i = 0; i < byte_count; i++) {
+		bytes[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+__attribute__ ((warn_unused_result))
+static uint64_t load_le(unsigned char const* const bytes, size_t const byte_count) {
+	uint64_t value = 0;
+
+	for (size_t i = byte_count; i-- > 0;) {
+		value = value << 8 | bytes[i];
+	}
+
+	return value;
+}
+
+__attribute__ ((warn_unused_result))
+static unsigned char* derivation_save(struct derivation const* const derivation, size_t* const size) {
+	size_t const sitename_length = strlen(derivation->sitename);
+
+	if (sitename_length > 0xffff) {
+		fputs("The site name is too long to checkpoint.\n", stderr);
+		return NULL;
+	}
+
+	*size = CHECKPOINT_HEADER_SIZE + sitename_length;
+	unsigned char* const buffer = malloc(*size);
+
+	if (buffer == NULL) {
+		fputs("Failed to allocate memory.\n", stderr);
+		return NULL;
+	}
+
+	unsigned char* p = buffer;
+
+	memcpy(p, checkpoint_magic, sizeof checkpoint_magic);
+	p += sizeof checkpoint_magic;
+	*p++ = CHECKPOINT_VERSION;
+	store_le(p, derivation->scheme.iterations, 4);
+	p += 4;
+	store_le(p, derivation->scheme.block_size, 8);
+	p += 8;
+	store_le(p, derivation->remaining_bits, 8);
+	p += 8;
+	SaveSponge(&derivation->state, p);
+	p += KeccakSpongeSavedSize;
+	store_le(p, sitename_length, 2);
+	p += 2;
+	memcpy(p, derivation->sitename, sitename_length);
+
+	return buffer;
+}
+
+/* Restores a derivation set up by derivation_init for the same site from a checkpoint. */
+__attribute__ ((warn_unused_result))
+static int derivation_restore(struct derivation* const derivation, unsigned char const* const buffer, size_t const size) {
+	struct password_scheme const* const scheme = &derivation->scheme;
+	unsigned char const* p = buffer;
+
+	if (size <= sizeof checkpoint_magic || memcmp(p, checkpoint_magic, sizeof checkpoint_magic) != 0) {
+		fputs("The checkpoint is not valid.\n", stderr);
+		return 1;
+	}
+
+	p += sizeof checkpoint_magic;
+
+	if (*p++ != CHECKPOINT_VERSION) {
+		fputs("The checkpoint version is not supported.\n", stderr);
+		return 1;
+	}
+
+	if (size < CHECKPOINT_HEADER_SIZE) {
+		fputs("The checkpoint is not valid.\n", stderr);
+		return 1;
+	}
+
+	uint64_t const iterations = load_le(p, 4);
+	uint64_t const block_size = load_le(p + 4, 8);
+	uint64_t const remaining_bits = load_le(p + 12, 8);
+	p += 20;
+
+	spongeState state;
+
+	if (RestoreSponge(&state, p) != 0 || state.squeezing ||
+			remaining_bits > (unsigned long long)scheme->iterations * scheme->block_size * 8) {
+		fputs("The checkpoint is not valid.\n", stderr);
+		return 1;
+	}
+
+	p += KeccakSpongeSavedSize;
+
+	if (iterations != scheme->iterations || block_size != scheme->block_size ||
+			state.rate != scheme->rate || state.nrRounds != scheme->rounds) {
+		fputs("The checkpoint doesn't match the configured scheme.\n", stderr);
+		memset(&state, 0, sizeof state);
+		return 1;
+	}
+
+	size_t const sitename_length = (size_t)load_le(p, 2);
+	p += 2;
+
+	if (size != CHECKPOINT_HEADER_SIZE + sitename_length) {
+		fputs("The checkpoint is not valid.\n", stderr);
+		memset(&state, 0, sizeof state);
+		return 1;
+	}
+
+	if (sitename_length != strlen(derivation->sitename) || memcmp(p, derivation->sitename, sitename_length) != 0) {
+		fputs("The checkpoint is for a different site.\n", stderr);
+		memset(&state, 0, sizeof state);
+		return 1;
+	}
+
+	derivation->state = state;
+	derivation->remaining_bits = remaining_bits;
+	memset(&state, 0, sizeof state);
+
+	return 0;
+}
+
+/* Replaces the checkpoint with the derivation's current state through a new file, so a crash
+ * leaves either the old checkpoint or the new one. */
+__attribute__ ((warn_unused_result))
+static int checkpoint_write(char const* const path, struct derivation const* const derivation) {
+	size_t size;
+	unsigned char* const buffer = derivation_save(derivation, &size);
+
+	if (buffer == NULL) {
+		return 1;
+	}
+
+	size_t const path_length = strlen(path);
+	char* const temporary_path = malloc(path_length + sizeof ".tmp");
+	int error = temporary_path == NULL;
+
+	if (!error) {
+		memcpy(temporary_path, path, path_length);
+		memcpy(temporary_path + path_length, ".tmp", sizeof ".tmp");
+
+		unlink(temporary_path);
+
+		int const fd = open(temporary_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+		error = fd == -1;
+
+		for (size_t written = 0; !error && written < size;) {
+			ssize_t const result = write(fd, buffer + written, size - written);
+
+			if (result > 0) {
+				written += (size_t)result;
+			} else if (result == 0 || errno != EINTR) {
+				error = 1;
+			}
+		}
+
+		if (fd != -1) {
+			error = fsync(fd) != 0 || error;
+			error = close(fd) != 0 || error;
+			error = error || rename(temporary_path, path) != 0;
+
+			if (error) {
+				unlink(temporary_path);
+			}
+		}
+	}
+
+	if (error) {
+		fputs("Failed to write checkpoint.\n", stderr);
+	}
+
+	memset(buffer, 0, size);
+	free(buffer);
+	free(temporary_path);
+
+	return error;
+}
+
+/* Restores the derivation from the checkpoint at path if there is one, setting resumed. */
+__attribute__ ((warn_unused_result))
+static int checkpoint_read(char const* const path, struct derivation* const derivation, int* const resumed) {
+	FILE* const checkpoint = fopen(path, "rb");
+
+	*resumed = 0;
+
+	if (checkpoint == NULL) {
+		if (errno == ENOENT) {
+			return 0;
+		}
+
+		fputs("Failed to open checkpoint.\n", stderr);
+		return 1;
+	}
+
+	unsigned char buffer[CHECKPOINT_HEADER_SIZE + 0xffff + 1];
+	size_t const size = fread(buffer, 1, sizeof buffer, checkpoint);
+	int error = ferror(checkpoint);
+
+	fclose(checkpoint);
+
+	if (error) {
+		fputs("Failed to read checkpoint.\n", stderr);
+	} else {
+		error = derivation_restore(derivation, buffer, size);
+	}
+
+	memset(buffer, 0, size);
+	*resumed = !error;
+
+	return error;
+}
+
+/* Runs the derivation's remaining iterations, checkpointing along the way, then prints its
+ * password and removes the checkpoint. */
+__attribute__ ((warn_unused_result))
+static int checkpoint_run(char const* const path, struct derivation* const derivation) {
+	while (derivation->remaining_bits != 0) {
+		if (derivation_step(derivation, CHECKPOINT_PERMUTATIONS) != 0 ||
+				checkpoint_write(path, derivation) != 0) {
+			return 1;
+		}
+	}
+
+	char* const result = derivation_render(derivation);
+
+	memset(&derivation->state, 0, sizeof derivation->state);
+
+	if (result == NULL) {
+		return 1;
+	}
+
+	puts(result);
+	free(result);
+
+	if (unlink(path) != 0 && errno != ENOENT) {
+		fputs("Failed to remove checkpoint.\n", stderr);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void batch_discard(struct derivation* const derivation) {
+	free((char*)derivation->sitename);
+	free(derivation->identifier);
+	password_bases_free(derivation->scheme.last_base);
+	memset(&derivation->state, 0, sizeof derivation->state);
+}
+
+/* Stable across platforms and runs, so every shard agrees on which sites are its own. */
+__attribute__ ((warn_unused_result))
+static unsigned long shard_of(char const* const sitename, size_t const length, unsigned long const count) {
+	uint64_t hash = 0xcbf29ce484222325;
+
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (unsigned char)sitename[i]) * 0x100000001b3;
+	}
+
+	return (unsigned long)(hash % count);
+}
+
+__attribute__ ((warn_unused_result))
+static int shard_parse(struct shard* const shard, char const* const spec) {
+	char* end;
+
+	errno = 0;
+	shard->index = strtoul(spec, &end, 10);
+
+	if (end != spec && *end == '/') {
+		char const* const count_spec = end + 1;
+		shard->count = strtoul(count_spec, &end, 10);
+
+		if (end != count_spec && *end == '\0' && errno == 0 &&
+				shard->index >= 1 && shard->index <= shard->count) {
+			shard->index--;
+			shard->sites = 0;
+			SHA3_256_Init(&shard->list_digest);
+			SHA3_256_Init(&shard->checksum);
+			return 0;
+		}
+	}
+
+	fputs("A shard must be given as <i>/<N> with 1 <= i <= N.\n", stderr);
+	return 1;
+}
+
+static void hex_encode(unsigned char const* const bytes, size_t const byte_count, char* const hex) {
+	static char const digits[] = "0123456789abcdef";
+
+	for (size_t i = 0; i < byte_count; i++) {
+		hex[2 * i] = digits[bytes[i] >> 4];
+		hex[2 * i + 1] = digits[bytes[i] & 0xf];
+	}
+
+	hex[2 * byte_count] = '\0';
+}
+
+__attribute__ ((warn_unused_result))
+static int segment_write(struct shard* const shard, char const* const text) {
+	size_t const length = strlen(text);
+
+	if (SHA3_256_Update(&shard->checksum, (unsigned char const*)text, length) != 0 ||
+			fwrite(text, 1, length, stdout) != length) {
+		fputs("Failed to write segment.\n", stderr);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Ends a segment with a trailer naming its shard, the number of sites in the whole list and the
+ * list's digest, followed by a checksum of every byte of the segment before it. */
+__attribute__ ((warn_unused_result))
+static int segment_finish(struct shard* const shard) {
+	unsigned char digest[32];
+	char digest_hex[65];
+	char trailer[128];
+
+	if (SHA3_256_Final(&shard->list_digest, digest) != 0) {
+		return 1;
+	}
+
+	hex_encode(digest, sizeof digest, digest_hex);
+	snprintf(trailer, sizeof trailer, "#cpassacre-segment 1\t%lu/%lu\t%lu\t%s\t", shard->index + 1, shard->count, shard->sites, digest_hex);
+
+	if (segment_write(shard, trailer) != 0 || SHA3_256_Final(&shard->checksum, digest) != 0) {
+		return 1;
+	}
+
+	hex_encode(digest, sizeof digest, digest_hex);
+
+	if (printf("%s\n", digest_hex) < 0 || fflush(stdout) != 0) {
+		fputs("Failed to write segment.\n", stderr);
+		return 1;
+	}
+
+	return 0;
+}
+
+__attribute__ ((warn_unused_result))
+static int bases_equal(struct password_base const* a, struct password_base const* b) {
+	for (; a != NULL && b != NULL; a = a->next, b = b->next) {
+		if (a->option_count != b->option_count || memcmp(a->options, b->options, a->option_count) != 0) {
+			return 0;
+		}
+	}
+
+	return a == b;
+}
+
+static void batch_pending_discard(struct batch* const batch) {
+	for (unsigned int i = 0; i < batch->count; i++) {
+		free((char*)batch->passwords[i].sitename);
+		memset(batch->passwords[i].output, 0, sizeof batch->passwords[i].output);
+	}
+
+	password_bases_free(batch->last_base);
+	batch->last_base = NULL;
+	batch->count = 0;
+}
+
+/* Converts and prints the pending passwords in order, then discards them. Without a shard, each
+ * is printed as a tab-separated site name and password; with one, as a segment record that starts
+ * with the site's line number in the list. */
+__attribute__ ((warn_unused_result))
+static int batch_convert(struct batch* const batch) {
+	if (batch->count == 0) {
+		return 0;
+	}
+
+	size_t const result_size = batch->length + 1;
+	char* const buffer = malloc(batch->count * result_size);
+	unsigned char* outputs[BATCH_PENDING];
+	char* results[BATCH_PENDING];
+	int error = buffer == NULL;
+
+	if (error) {
+		fputs("Failed to allocate memory.\n", stderr);
+	} else {
+		for (unsigned int i = 0; i < batch->count; i++) {
+			outputs[i] = batch->passwords[i].output;
+			results[i] = buffer + i * result_size;
+		}
+
+		passwords_convert(batch->last_base, outputs, batch->count, batch->output_bytes, results, batch->length);
+	}
+
+	for (unsigned int i = 0; i < batch->count && !error; i++) {
+		struct batch_password const* const password = &batch->passwords[i];
+
+		if (batch->shard == NULL) {
+			printf("%s\t%s\n", password->sitename, results[i]);
+		} else {
+			char line[32];
+
+			snprintf(line, sizeof line, "%lu\t", password->line);
+
+			error =
+				segment_write(batch->shard, line) != 0 ||
+				segment_write(batch->shard, password->sitename) != 0 ||
+				segment_write(batch->shard, "\t") != 0 ||
+				segment_write(batch->shard, results[i]) != 0 ||
+				segment_write(batch->shard, "\n") != 0;
+		}
+	}
+
+	if (buffer != NULL) {
+		memset(buffer, 0, batch->count * result_size);
+		free(buffer);
+	}
+
+	batch_pending_discard(batch);
+
+	return error;
+}
+
+/* Squeezes an iterated derivation into the pending passwords, taking its site name and bases, and
+ * converts the pending passwords first if they're full or have other bases. */
+__attribute__ ((warn_unused_result))
+static int batch_add(struct batch* const batch, struct derivation* const derivation, unsigned long const line) {
+	size_t const output_bytes = bytes_required_for(derivation->scheme.last_base);
+
+	if (output_bytes == 0 || output_bytes > sizeof batch->passwords[0].output) {
+		fputs("A password must have between 1 and 8192 bits of entropy.\n", stderr);
+		return 1;
+	}
+
+	if (batch->count == BATCH_PENDING || (batch->count != 0 && !bases_equal(batch->last_base, derivation->scheme.last_base))) {
+		if (batch_convert(batch) != 0) {
+			return 1;
+		}
+	}
+
+	struct batch_password* const password = &batch->passwords[batch->count];
+
+	if (derivation_squeeze(derivation, password->output, output_bytes) != 0) {
+		return 1;
+	}
+
+	if (batch->count == 0) {
+		batch->last_base = derivation->scheme.last_base;
+		batch->length = derivation->scheme.length;
+		batch->output_bytes = output_bytes;
+	} else {
+		password_bases_free(derivation->scheme.last_base);
+	}
+
+	derivation->scheme.last_base = NULL;
+	password->sitename = derivation->sitename;
+	password->line = line;
+	derivation->sitename = NULL;
+	batch->count++;
+
+	return 0;
+}
+
+/* Derives a password for each line of the site list, printing a tab-separated site name and
+ * password per line in order. Consecutive passwords that share bases are converted together.
+ * With a shard, only the sites that hash to it are derived, and they're written as a segment for
+ * segments_merge. */
+__attribute__ ((warn_unused_result))
+static int batch_run(FILE* const site_list, unsigned char const* const password, size_t const password_length, struct shard* const shard) {
+	struct batch batch;
+	unsigned long line_number = 0;
+	char line[1024];
+
+	batch.shard = shard;
+	batch.last_base = NULL;
+	batch.count = 0;
+
+	while (fgets(line, sizeof line, site_list) != NULL) {
+		size_t line_length = strlen(line);
+
+		line_number++;
+
+		if (shard != NULL && SHA3_256_Update(&shard->list_digest, (unsigned char const*)line, line_length) != 0) {
+			batch_pending_discard(&batch);
+			return 1;
+		}
+
+		if (line_length != 0 && line[line_length - 1] == '\n') {
+			line_length--;
+		} else if (line_length == sizeof line - 1) {
+			fputs("The maximum site name length is 1022 characters.\n", stderr);
+			batch_pending_discard(&batch);
+			return 1;
+		}
+
+		if (line_length == 0) {
+			continue;
+		}
+
+		if (shard != NULL) {
+			shard->sites++;
+
+			if (shard_of(line, line_length, shard->count) != shard->index) {
+				continue;
+			}
+		}
+
+		char* const sitename = malloc(line_length + 1);
+
+		if (sitename == NULL) {
+			fputs("Failed to allocate memory.\n", stderr);
+			batch_pending_discard(&batch);
+			return 1;
+		}
+
+		memcpy(sitename, line, line_length);
+		sitename[line_length] = '\0';
+
+		struct derivation derivation;
+
+		if (derivation_init(&derivation, sitename) != 0) {
+			free(sitename);
+			batch_pending_discard(&batch);
+			return 1;
+		}
+
+		int const error =
+			derivation_absorb(&derivation, password, password_length) != 0 ||
+			derivation_iterate(&derivation) != 0 ||
+			batch_add(&batch, &derivation, line_number) != 0;
+
+		batch_discard(&derivation);
+
+		if (error) {
+			batch_pending_discard(&batch);
+			return 1;
+		}
+	}
+
+	if (ferror(site_list)) {
+		fputs("Failed to read site list.\n", stderr);
+		batch_pending_discard(&batch);
+		return 1;
+	}
+
+	int const error =
+		batch_convert(&batch) != 0 ||
+		(shard != NULL && segment_finish(shard) != 0);
+
+	batch_pending_discard(&batch);
+
+	return error;
+}
+
+__attribute__ ((warn_unused_result))
+static char* file_read(char const* const path, size_t* const size) {
+	FILE* const file = fopen(path, "rb");
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	size_t capacity = 4096;
+	char* data = malloc(capacity);
+
+	*size = 0;
+
+	while (data != NULL) {
+		*size += fread(data + *size, 1, capacity - *size, file);
+
+		if (*size < capacity || ferror(file)) {
+			break;
+		}
+
+		/* Copied rather than reallocated so that the old buffer can be wiped. */
+		char* const grown = malloc(capacity * 2);
+
+		if (grown != NULL) {
+			memcpy(grown, data, capacity);
+		}
+
+		memset(data, 0, capacity);
+		free(data);
+		data = grown;
+		capacity *= 2;
+	}
+
+	if (data != NULL && ferror(file)) {
+		memset(data, 0, capacity);
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+
+	/* The terminator lets the parser use the string functions. */
+	if (data != NULL) {
+		data[*size] = '\0';
+	}
+
+	return data;
+}
+
+/* Checks a segment's trailer and checksum and appends its records, which must all belong to its
+ * shard and be in list order. */
+__attribute__ ((warn_unused_result))
+static int segment_parse(char const* const path, char* const data, size_t const size, struct shard* const shard, char* const list_digest, struct segment_record** const records, size_t* const record_count) {
+	static char const trailer_prefix[] = "#cpassacre-segment ";
+
+	if (size == 0 || data[size - 1] != '\n') {
+		fprintf(stderr, "%s: The segment is truncated.\n", path);
+		return 1;
+	}
+
+	char* trailer = data + size - 1;
+
+	while (trailer != data && trailer[-1] != '\n') {
+		trailer--;
+	}
+
+	if (strncmp(trailer, trailer_prefix, sizeof trailer_prefix - 1) != 0) {
+		fprintf(stderr, "%s: The segment is truncated.\n", path);
+		return 1;
+	}
+
+	if (strncmp(trailer + sizeof trailer_prefix - 1, "1\t", 2) != 0) {
+		fprintf(stderr, "%s: The segment version is not supported.\n", path);
+		return 1;
+	}
+
+	char* const checksum_hex = strrchr(trailer, '\t') + 1;
+	unsigned char checksum[32];
+	char expected_hex[65];
+
+	SHA3_256((unsigned char const*)data, (size_t)(checksum_hex - data), checksum);
+	hex_encode(checksum, sizeof checksum, expected_hex);
+
+	if (strlen(checksum_hex) != 65 || memcmp(checksum_hex, expected_hex, 64) != 0) {
+		fprintf(stderr, "%s: The segment checksum doesn't match.\n", path);
+		return 1;
+	}
+
+	int digest_length = 0;
+
+	if (sscanf(trailer + sizeof trailer_prefix + 1, "%lu/%lu\t%lu\t%64[0-9a-f]%n", &shard->index, &shard->count, &shard->sites, list_digest, &digest_length) != 4 ||
+			digest_length == 0 || trailer[sizeof trailer_prefix + 1 + (size_t)digest_length] != '\t' ||
+			strlen(list_digest) != 64 || shard->index < 1 || shard->index > shard->count) {
+		fprintf(stderr, "%s: The segment trailer is not valid.\n", path);
+		return 1;
+	}
+
+	shard->index--;
+
+	unsigned long previous_line = 0;
+
+	for (char* line = data; line != trailer;) {
+		char* const end = memchr(line, '\n', (size_t)(trailer - line));
+
+		if (end == NULL || memchr(line, '\0', (size_t)(end - line)) != NULL) {
+			fprintf(stderr, "%s: The segment has a record that is not valid.\n", path);
+			return 1;
+		}
+
+		char* const first_tab = memchr(line, '\t', (size_t)(end - line));
+		char* last_tab = end;
+
+		while (last_tab != line && *last_tab != '\t') {
+			last_tab--;
+		}
+
+		char* number_end;
+		unsigned long const line_number = strtoul(line, &number_end, 10);
+
+		if (first_tab == NULL || first_tab == last_tab || number_end != first_tab ||
+				*line < '0' || *line > '9' || line_number <= previous_line ||
+				shard_of(first_tab + 1, (size_t)(last_tab - first_tab - 1), shard->count) != shard->index) {
+			fprintf(stderr, "%s: The segment has a record that is not valid.\n", path);
+			return 1;
+		}
+
+		if (*record_count % 1024 == 0) {
+			struct segment_record* const grown = realloc(*records, (*record_count + 1024) * sizeof(struct segment_record));
+
+			if (grown == NULL) {
+				fputs("Failed to allocate memory.\n", stderr);
+				return 1;
+			}
+
+			*records = grown;
+		}
+
+		*last_tab = '\0';
+		*end = '\0';
+
+		(*records)[(*record_count)++] = (struct segment_record){
+			.line = line_number,
+			.sitename = first_tab + 1,
+			.password = last_tab + 1,
+		};
+
+		previous_line = line_number;
+		line = end + 1;
+	}
+
+	return 0;
+}
+
+static int segment_record_compare(void const* const a, void const* const b) {
+	unsigned long const line_a = ((struct segment_record const*)a)->line;
+	unsigned long const line_b = ((struct segment_record const*)b)->line;
+
+	return (line_a > line_b) - (line_a < line_b);
+}
+
+/* Verifies that the segments are every shard of one site list, each exactly once and with all
+ * their sites, and prints their records in list order as batch_run would without shards. */
+__attribute__ ((warn_unused_result))
+static int segments_merge(char const* const* const paths, size_t const count) {
+	char** const data = calloc(count, sizeof(char*));
+	size_t* const sizes = calloc(count, sizeof(size_t));
+	unsigned long sites = 0;
+	char first_digest[65];
+	unsigned char* seen = NULL;
+	struct segment_record* records = NULL;
+	size_t record_count = 0;
+	int error = data == NULL || sizes == NULL;
+
+	if (error) {
+		fputs("Failed to allocate memory.\n", stderr);
+	}
+
+	for (size_t i = 0; i < count && !error; i++) {
+		struct shard shard;
+		char list_digest[65];
+
+		data[i] = file_read(paths[i], &sizes[i]);
+
+		if (data[i] == NULL) {
+			fprintf(stderr, "%s: Failed to read segment.\n", paths[i]);
+			error = 1;
+		} else if (segment_parse(paths[i], data[i], sizes[i], &shard, list_digest, &records, &record_count) != 0) {
+			error = 1;
+		} else if (i == 0) {
+			sites = shard.sites;
+			memcpy(first_digest, list_digest, sizeof first_digest);
+			seen = calloc(shard.count, 1);
+
+			if (seen == NULL || shard.count != count) {
+				fputs(seen == NULL ? "Failed to allocate memory.\n" : "The segments are incomplete.\n", stderr);
+				error = 1;
+			}
+		} else if (shard.count != count || shard.sites != sites || strcmp(list_digest, first_digest) != 0) {
+			fprintf(stderr, "%s: The segment is from a different site list or shard count.\n", paths[i]);
+			error = 1;
+		}
+
+		if (!error) {
+			if (seen[shard.index]) {
+				fprintf(stderr, "%s: The segment's shard was already given.\n", paths[i]);
+				error = 1;
+			}
+
+			seen[shard.index] = 1;
+		}
+	}
+
+	if (!error) {
+		qsort(records, record_count, sizeof(struct segment_record), segment_record_compare);
+
+		if (record_count != sites) {
+			fputs("The segments are incomplete.\n", stderr);
+			error = 1;
+		}
+	}
+
+	for (size_t i = 0; i < record_count && !error; i++) {
+		if (printf("%s\t%s\n", records[i].sitename, records[i].password) < 0) {
+			fputs("Failed to write output.\n", stderr);
+			error = 1;
+		}
+	}
+
+	for (size_t i = 0; data != NULL && i < count; i++) {
+		if (data[i] != NULL) {
+			memset(data[i], 0, sizes[i]);
+			free(data[i]);
+		}
+	}
+
+	free(data);
+	free(sizes);
+	free(seen);
+	free(records);
+
+	return error;
+}
+
+#if defined(__linux__)
+/* The server shares one region with its clients: an array of request slots and a multi-producer
+ * ring through which clients submit slot numbers. A dispatcher thread drains the ring into each
+ * worker's single-producer ring, and the worker writes the result back into the slot. Every wait
+ * is on a futex, and a futex is only woken when the side waiting on it has said it's asleep, so a
+ * busy server makes no system calls to pass requests along. */
+
+#if ATOMIC_INT_LOCK_FREE != 2 || ATOMIC_LLONG_LOCK_FREE != 2
+#error "The server needs lock-free atomics to share them between processes."
+#endif
+
+/* A power of two, so that ring positions can wrap by masking. */
+#define SERVER_SLOTS 64
+#define SERVER_VERSION 2
+#define SERVER_RECLAIMING UINT32_MAX
+
+enum {
+	SLOT_FREE,
+	SLOT_CLAIMED,
+	SLOT_SUBMITTED,
+	SLOT_QUEUED,
+	SLOT_DONE,
+	SLOT_CANCELLED,
+};
+
+/* A slot belongs to the client whose process ID is its owner, from claiming it until freeing it. */
+struct server_slot {
+	_Atomic uint32_t owner;
+	_Atomic uint32_t state;
+	_Atomic uint32_t waiting;
+	uint32_t error;
+	char sitename[1024];
+	char scheme[256];
+	char result[1025];
+};
+
+struct server_cell {
+	_Atomic uint64_t sequence;
+	uint32_t slot;
+};
+
+struct server_region {
+	unsigned char magic[4];
+	uint32_t version;
+	_Atomic uint64_t submit_tail;
+	_Atomic uint32_t submit_events;
+	_Atomic uint32_t dispatcher_sleeping;
+	_Atomic uint32_t free_events;
+	_Atomic uint32_t free_waiters;
+	struct server_cell submit_ring[SERVER_SLOTS];
+	struct server_slot slots[SERVER_SLOTS];
+};
+
+static unsigned char const server_magic[4] = {'c', 'p', 's', 'r'};
+
+struct server_prefix {
+	unsigned int rate;
+	unsigned int rounds;
+	spongeState state;
+};
+
+/* A site's scheme and identifier, parsed once for the requests that repeat it. */
+struct server_site {
+	int parsed;
+	char sitename[1024];
+	char scheme_text[256];
+	struct password_scheme scheme;
+	char* identifier;
+};
+
+struct server_worker {
+	struct server_region* region;
+	unsigned char const* password;
+	size_t password_length;
+	pthread_t thread;
+	uint32_t ring[SERVER_SLOTS];
+	_Atomic uint64_t head;
+	_Atomic uint64_t tail;
+	_Atomic uint32_t events;
+	_Atomic uint32_t sleeping;
+	unsigned int prefix_count;
+	unsigned int prefix_next;
+	struct server_prefix prefixes[4];
+	unsigned int site_next;
+	struct server_site sites[16];
+};
+
+static void futex_wait(_Atomic uint32_t* const address, uint32_t const expected, struct timespec const* const timeout) {
+	syscall(SYS_futex, (uint32_t*)address, FUTEX_WAIT, expected, timeout, NULL, 0);
+}
+
+static void futex_wake(_Atomic uint32_t* const address) {
+	syscall(SYS_futex, (uint32_t*)address, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+/* Waits for *events to move past a value read before checking for work, unless the check finds
+ * some after the sleeping flag is raised, or until the timeout if there is one. */
+static void server_sleep(_Atomic uint32_t* const events, _Atomic uint32_t* const sleeping, int (*const has_work)(void const*), void const* const arg, struct timespec const* const timeout) {
+	uint32_t const seen = atomic_load(events);
+
+	atomic_store(sleeping, 1);
+
+	if (!has_work(arg)) {
+		futex_wait(events, seen, timeout);
+	}
+
+	atomic_store(sleeping, 0);
+}
+
+static void server_notify(_Atomic uint32_t* const events, _Atomic uint32_t* const sleeping) {
+	atomic_fetch_add(events, 1);
+
+	if (atomic_load(sleeping)) {
+		futex_wake(events);
+	}
+}
+
+/* Called by clients and by the server for slots whose clients died. */
+static void server_slot_free(struct server_region* const region, struct server_slot* const slot) {
+	memset(slot->result, 0, sizeof slot->result);
+	atomic_store(&slot->waiting, 0);
+	atomic_store(&slot->state, SLOT_FREE);
+	atomic_store(&slot->owner, 0);
+	atomic_fetch_add(&region->free_events, 1);
+
+	if (atomic_load(&region->free_waiters) != 0) {
+		futex_wake(&region->free_events);
+	}
+}
+
+/* Frees the slots of clients that were killed before freeing them. Slots queued to a worker are
+ * cancelled instead, so that it skips them, and left until it's done with them; only the
+ * dispatcher, which calls this, queues them. */
+static void server_reclaim(struct server_region* const region) {
+	for (uint32_t i = 0; i < SERVER_SLOTS; i++) {
+		struct server_slot* const slot = &region->slots[i];
+		uint32_t owner = atomic_load(&slot->owner);
+		uint32_t state = atomic_load(&slot->state);
+
+		if (owner == 0 || owner == SERVER_RECLAIMING || state == SLOT_CANCELLED ||
+				kill((pid_t)owner, 0) == 0 || errno != ESRCH) {
+			continue;
+		}
+
+		/* A worker may have finished the slot since its state was read. */
+		if (state == SLOT_QUEUED) {
+			atomic_compare_exchange_strong(&slot->state, &state, SLOT_CANCELLED);
+			continue;
+		}
+
+		/* The slot may have been freed and claimed again since its owner was read. */
+		if (atomic_compare_exchange_strong(&slot->owner, &owner, SERVER_RECLAIMING)) {
+			server_slot_free(region, slot);
+		}
+	}
+}
+
+static int server_slots_owned(struct server_region const* const region) {
+	for (uint32_t i = 0; i < SERVER_SLOTS; i++) {
+		if (atomic_load(&region->slots[i].owner) != 0) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/* Called by clients; the ring can't fill, since it has a cell for every slot. */
+static void server_submit(struct server_region* const region, uint32_t const slot) {
+	uint64_t position = atomic_load(&region->submit_tail);
+	struct server_cell* cell;
+
+	for (;;) {
+		cell = &region->submit_ring[position & (SERVER_SLOTS - 1)];
+
+		if (atomic_load(&cell->sequence) == position) {
+			if (atomic_compare_exchange_weak(&region->submit_tail, &position, position + 1)) {
+				break;
+			}
+		} else {
+			position = atomic_load(&region->submit_tail);
+		}
+	}
+
+	cell->slot = slot;
+	atomic_store(&cell->sequence, position + 1);
+	server_notify(&region->submit_events, &region->dispatcher_sleeping);
+}
+
+struct server_dispatcher {
+	struct server_region* region;
+	uint64_t head;
+};
+
+static int server_submitted(void const* const arg) {
+	struct server_dispatcher const* const dispatcher = arg;
+	struct server_cell const* const cell = &dispatcher->region->submit_ring[dispatcher->head & (SERVER_SLOTS - 1)];
+
+	return atomic_load(&cell->sequence) == dispatcher->head + 1;
+}
+
+static int server_worker_queued(void const* const arg) {
+	struct server_worker const* const worker = arg;
+
+	return atomic_load(&worker->head) != atomic_load(&worker->tail);
+}
+
+/* Finds or computes the state that has absorbed the password for a rate and number of rounds,
+ * keeping the few most recently computed. */
+__attribute__ ((warn_unused_result))
+static spongeState const* server_prefix_for(struct server_worker* const worker, struct password_scheme const* const scheme) {
+	for (unsigned int i = 0; i < worker->prefix_count; i++) {
+		if (worker->prefixes[i].rate == scheme->rate && worker->prefixes[i].rounds == scheme->rounds) {
+			return &worker->prefixes[i].state;
+		}
+	}
+
+	unsigned int const i = worker->prefix_next;
+	struct server_prefix* const prefix = &worker->prefixes[i];
+
+	worker->prefix_next = (i + 1) % (sizeof worker->prefixes / sizeof *worker->prefixes);
+
+	if (worker->prefix_count <= i) {
+		worker->prefix_count = i + 1;
+	}
+
+	prefix->rate = 0;
+
+	if (InitSpongeRounds(&prefix->state, scheme->rate, 1600 - scheme->rate, scheme->rounds) != 0 ||
+			Absorb(&prefix->state, worker->password, worker->password_length * 8) != 0) {
+		fputs("Failed to absorb into sponge.\n", stderr);
+		return NULL;
+	}
+
+	prefix->rate = scheme->rate;
+	prefix->rounds = scheme->rounds;
+
+	return &prefix->state;
+}
+
+/* Finds or parses the scheme and identifier for a site name and alternative scheme, keeping the
+ * most recently parsed so that repeated requests don't allocate. */
+__attribute__ ((warn_unused_result))
+static struct server_site const* server_site_for(struct server_worker* const worker, char const* const sitename, char const* const scheme_text) {
+	for (unsigned int i = 0; i < sizeof worker->sites / sizeof *worker->sites; i++) {
+		struct server_site const* const site = &worker->sites[i];
+
+		if (site->parsed && strcmp(site->sitename, sitename) == 0 && strcmp(site->scheme_text, scheme_text) == 0) {
+			return site;
+		}
+	}
+
+	struct server_site* const site = &worker->sites[worker->site_next];
+
+	worker->site_next = (worker->site_next + 1) % (sizeof worker->sites / sizeof *worker->sites);
+
+	free(site->identifier);
+	password_bases_free(site->scheme.last_base);
+	site->parsed = 0;
+	strcpy(site->sitename, sitename);
+	strcpy(site->scheme_text, scheme_text);
+
+	struct derivation derivation;
+	int error = derivation_init(&derivation, site->sitename) != 0;
+
+	if (!error && scheme_text[0] != '\0') {
+		struct password_scheme alternative;
+
+		error = password_scheme_parse(&alternative, scheme_text) != 0;
+
+		if (!error) {
+			password_bases_free(derivation.scheme.last_base);
+			derivation.scheme.last_base = alternative.last_base;
+			derivation.scheme.length = alternative.length;
+		}
+	}
+
+	/* Kept even on failure, to be freed when the entry is reused. */
+	site->scheme = derivation.scheme;
+	site->identifier = derivation.identifier;
+	memset(&derivation.state, 0, sizeof derivation.state);
+
+	if (error) {
+		return NULL;
+	}
+
+	site->parsed = 1;
+	return site;
+}
+
+__attribute__ ((warn_unused_result))
+static int server_derive(struct server_worker* const worker, struct server_slot* const slot) {
+	/* The region is shared with clients, so nothing in it can be trusted to be terminated. */
+	slot->sitename[sizeof slot->sitename - 1] = '\0';
+	slot->scheme[sizeof slot->scheme - 1] = '\0';
+
+	struct server_site const* const site = server_site_for(worker, slot->sitename, slot->scheme);
+
+	if (site == NULL) {
+		return 1;
+	}
+
+	spongeState const* const prefix = server_prefix_for(worker, &site->scheme);
+
+	if (prefix == NULL) {
+		return 1;
+	}
+
+	struct derivation derivation;
+
+	derivation.state = *prefix;
+	derivation.scheme = site->scheme;
+	derivation.sitename = site->sitename;
+	derivation.identifier = site->identifier;
+
+	int const error =
+		derivation_absorb_site(&derivation) != 0 ||
+		derivation_iterate(&derivation) != 0 ||
+		derivation_render_into(&derivation, slot->result, sizeof slot->result) != 0;
+
+	memset(&derivation.state, 0, sizeof derivation.state);
+
+	return error;
+}
+
+static void* server_worker_run(void* const arg) {
+	struct server_worker* const worker = arg;
+
+	for (;;) {
+		uint64_t const head = atomic_load(&worker->head);
+
+		if (head == atomic_load(&worker->tail)) {
+			server_sleep(&worker->events, &worker->sleeping, server_worker_queued, worker, NULL);
+			continue;
+		}
+
+		struct server_slot* const slot = &worker->region->slots[worker->ring[head & (SERVER_SLOTS - 1)]];
+
+		atomic_store(&worker->head, head + 1);
+
+		/* Requests from clients killed while waiting are dropped instead of derived. */
+		slot->result[0] = '\0';
+		slot->error = atomic_load(&slot->state) == SLOT_CANCELLED || server_derive(worker, slot) != 0;
+		atomic_store(&slot->state, SLOT_DONE);
+
+		if (atomic_load(&slot->waiting)) {
+			futex_wake(&slot->state);
+		}
+	}
+
+	return NULL;
+}
+
+/* Serves derivations with the password to clients of a new shared region until killed, handing
+ * each request to the worker with the fewest queued. */
+__attribute__ ((warn_unused_result))
+static int server_run(unsigned char const* const password, size_t const password_length, unsigned int const worker_count) {
+	int const fd = (int)syscall(SYS_memfd_create, "cpassacre", 0);
+
+	if (fd == -1 || ftruncate(fd, sizeof(struct server_region)) != 0) {
+		fputs("Failed to create shared memory.\n", stderr);
+		return 1;
+	}
+
+	struct server_region* const region = mmap(NULL, sizeof(struct server_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	struct server_worker* const workers = calloc(worker_count, sizeof(struct server_worker));
+
+	if (region == MAP_FAILED || workers == NULL) {
+		fputs("Failed to allocate memory.\n", stderr);
+		return 1;
+	}
+
+	if (mlock(region, sizeof(struct server_region)) != 0 ||
+			mlock(workers, worker_count * sizeof(struct server_worker)) != 0 ||
+			mlock(password, password_length) != 0) {
+		fputs("Failed to lock memory.\n", stderr);
+		return 1;
+	}
+
+	memcpy(region->magic, server_magic, sizeof server_magic);
+	region->version = SERVER_VERSION;
+
+	for (uint32_t i = 0; i < SERVER_SLOTS; i++) {
+		atomic_store(&region->submit_ring[i].sequence, i);
+	}
+
+	for (unsigned int i = 0; i < worker_count; i++) {
+		workers[i].region = region;
+		workers[i].password = password;
+		workers[i].password_length = password_length;
+
+		if (pthread_create(&workers[i].thread, NULL, server_worker_run, &workers[i]) != 0) {
+			fputs("Failed to start worker.\n", stderr);
+			return 1;
+		}
+	}
+
+	if (printf("/proc/%ld/fd/%d\n", (long)getpid(), fd) < 0 || fflush(stdout) != 0) {
+		return 1;
+	}
+
+	struct server_dispatcher dispatcher = {region, 0};
+	struct timespec const reclaim_interval = {1, 0};
+	struct timespec last_reclaim = {0, 0};
+
+	/* While any slot is owned, the dispatcher wakes up at least once a second to check whether
+	 * its client is still alive. */
+	for (;;) {
+		if (!server_submitted(&dispatcher)) {
+			struct timespec now;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+
+			if (now.tv_sec - last_reclaim.tv_sec >= reclaim_interval.tv_sec) {
+				server_reclaim(region);
+				last_reclaim = now;
+			}
+
+			server_sleep(&region->submit_events, &region->dispatcher_sleeping, server_submitted, &dispatcher,
+				server_slots_owned(region) ? &reclaim_interval : NULL);
+			continue;
+		}
+
+		struct server_cell* const cell = &region->submit_ring[dispatcher.head & (SERVER_SLOTS - 1)];
+		uint32_t const slot = cell->slot;
+
+		atomic_store(&cell->sequence, dispatcher.head + SERVER_SLOTS);
+		dispatcher.head++;
+
+		uint32_t submitted = SLOT_SUBMITTED;
+
+		/* A client can submit a slot more than once; it's only queued once per request. */
+		if (slot >= SERVER_SLOTS || !atomic_compare_exchange_strong(&region->slots[slot].state, &submitted, SLOT_QUEUED)) {
+			continue;
+		}
+
+		struct server_worker* worker = &workers[0];
+		uint64_t least_queued = UINT64_MAX;
+
+		for (unsigned int i = 0; i < worker_count; i++) {
+			uint64_t const queued = atomic_load(&workers[i].tail) - atomic_load(&workers[i].head);
+
+			if (queued < least_queued) {
+				worker = &workers[i];
+				least_queued = queued;
+			}
+		}
+
+		uint64_t const tail = atomic_load(&worker->tail);
+
+		worker->ring[tail & (SERVER_SLOTS - 1)] = slot;
+		atomic_store(&worker->tail, tail + 1);
+		server_notify(&worker->events, &worker->sleeping);
+	}
+}
+
+/* Submits a request to a server's region and prints the password it derives. */
+__attribute__ ((warn_unused_result))
+static int server_request(char const* const path, char const* const sitename, char const* const scheme) {
+	if (strlen(sitename) >= sizeof ((struct server_slot*)NULL)->sitename ||
+			strlen(scheme) >= sizeof ((struct server_slot*)NULL)->scheme) {
+		fputs("The site name or scheme is too long.\n", stderr);
+		return 1;
+	}
+
+	int const fd = open(path, O_RDWR);
+
+	if (fd == -1) {
+		fputs("Failed to open server.\n", stderr);
+		return 1;
+	}
+
+	struct server_region* const region = mmap(NULL, sizeof(struct server_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	close(fd);
+
+	if (region == MAP_FAILED) {
+		fputs("Failed to map server.\n", stderr);
+		return 1;
+	}
+
+	if (memcmp(region->magic, server_magic, sizeof server_magic) != 0 || region->version != SERVER_VERSION) {
+		fputs("The server is not compatible.\n", stderr);
+		munmap(region, sizeof(struct server_region));
+		return 1;
+	}
+
+	/* Clients start looking for a free slot at different places to avoid contending for one, and
+	 * wait for one to be freed if there are none. */
+	uint32_t const owner = (uint32_t)getpid();
+	struct server_slot* slot = NULL;
+
+	for (;;) {
+		uint32_t const seen = atomic_load(&region->free_events);
+
+		for (uint32_t i = 0; i < SERVER_SLOTS && slot == NULL; i++) {
+			uint32_t expected = 0;
+			struct server_slot* const candidate = &region->slots[(owner + i) & (SERVER_SLOTS - 1)];
+
+			if (atomic_compare_exchange_strong(&candidate->owner, &expected, owner)) {
+				slot = candidate;
+			}
+		}
+
+		if (slot != NULL) {
+			break;
+		}
+
+		atomic_fetch_add(&region->free_waiters, 1);
+		futex_wait(&region->free_events, seen, NULL);
+		atomic_fetch_sub(&region->free_waiters, 1);
+	}
+
+	atomic_store(&slot->state, SLOT_CLAIMED);
+	strcpy(slot->sitename, sitename);
+	strcpy(slot->scheme, scheme);
+	atomic_store(&slot->state, SLOT_SUBMITTED);
+	server_submit(region, (uint32_t)(slot - region->slots));
+
+	for (uint32_t state; (state = atomic_load(&slot->state)) != SLOT_DONE;) {
+		atomic_store(&slot->waiting, 1);
+		futex_wait(&slot->state, state, NULL);
+	}
+
+	int const error = slot->error != 0;
+
+	if (error) {
+		fputs("The server failed to derive the password.\n", stderr);
+	} else {
+		puts(slot->result);
+	}
+
+	server_slot_free(region, slot);
+	munmap(region, sizeof(struct server_region));
+
+	return error;
+}
+
+#define SERVER_USAGE "       cpassacre -S [<workers>]\n       cpassacre -q <server> <site name> [<scheme>]\n"
+#else
+#define SERVER_USAGE ""
+#endif
+
+int main(int const argc, char const* const argv[]) {
+	char const* sitename = NULL;
+	FILE* site_list = NULL;
+	char const* checkpoint_path = NULL;
+	struct shard shard;
+	struct shard* batch_shard = NULL;
+	char const* const* alternative_specs = NULL;
+	size_t alternative_count = 0;
+
+	if (argc >= 3 && strcmp(argv[1], "-m") == 0) {
+		return segments_merge(argv + 2, (size_t)(argc - 2)) != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+#if defined(__linux__)
+	unsigned long server_workers = 0;
+
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "-q") == 0) {
+		return server_request(argv[2], argv[3], argc == 5 ? argv[4] : "") != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+#endif
+
+	if ((argc == 3 || (argc == 5 && strcmp(argv[3], "--shard") == 0)) && strcmp(argv[1], "-b") == 0) {
+		if (argc == 5) {
+			if (shard_parse(&shard, argv[4]) != 0) {
+				return EXIT_FAILURE;
+			}
+
+			batch_shard = &shard;
+		}
+
+		site_list = fopen(argv[2], "r");
+
+		if (site_list == NULL) {
+			fputs("Failed to open site list.\n", stderr);
+			return EXIT_FAILURE;
+		}
+	} else if (argc == 4 && strcmp(argv[1], "-c") == 0) {
+		checkpoint_path = argv[2];
+		sitename = argv[3];
+#if defined(__linux__)
+	} else if ((argc == 2 || argc == 3) && strcmp(argv[1], "-S") == 0) {
+		long const processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+		server_workers = processors > 0 ? (unsigned long)processors : 1;
+
+		if (argc == 3) {
+			char* end;
+
+			server_workers = strtoul(argv[2], &end, 10);
+
+			if (end == argv[2] || *end != '\0' || server_workers == 0 || server_workers > 256) {
+				fputs("The number of workers must be between 1 and 256.\n", stderr);
+				return EXIT_FAILURE;
+			}
+		}
+#endif
+	} else if (argc >= 2) {
+		sitename = argv[1];
+		alternative_specs = argv + 2;
+		alternative_count = (size_t)(argc - 2);
+	} else {
+		fputs("Usage: cpassacre <site name> [<scheme>...]\n       cpassacre -b <site list> [--shard <i>/<N>]\n       cpassacre -m <segment>...\n       cpassacre -c <checkpoint> <site name>\n" SERVER_USAGE, stderr);
+		return EXIT_FAILURE;
+	}
+
+	struct derivation derivation;
+
+	if (sitename != NULL && derivation_init(&derivation, sitename) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	/* Alternative schemes replace the configured scheme's bases but keep its iterations, so each
+	 * renders the same password as a separate run configured with it. */
+	struct password_scheme* const alternatives = malloc(alternative_count * sizeof(struct password_scheme));
+
+	if (alternative_count != 0 && alternatives == NULL) {
+		fputs("Failed to allocate memory.\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < alternative_count; i++) {
+		if (password_scheme_parse(&alternatives[i], alternative_specs[i]) != 0) {
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (checkpoint_path != NULL) {
+		int resumed;
+
+		if (derivation.scheme.chains > 1) {
+			fputs("Derivations with chains can't be checkpointed.\n", stderr);
+			return EXIT_FAILURE;
+		}
+
+		if (checkpoint_read(checkpoint_path, &derivation, &resumed) != 0) {
+			return EXIT_FAILURE;
+		}
+
+		if (resumed) {
+			free(derivation.identifier);
+			return checkpoint_run(checkpoint_path, &derivation) != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+		}
+	}
+
+	unsigned char input[1024];
+
+	if (password_read((char*)input, sizeof input) == NULL) {
+		if (!feof(stdin)) {
+			fputs("Failed to read password.\n", stderr);
+			return EXIT_FAILURE;
+		}
+
+		input[0] = '\0';
+	}
+
+	size_t input_length = strlen((char*)input);
+
+	if (input[input_length - 1] == '\n') {
+		input_length--;
+	} else if (input_length > 1022) {
+		/* Avoid silent truncation at 1023 characters */
+		fputs("The maximum password length is 1022 characters.\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	input[input_length] = ':';
+
+#if defined(__linux__)
+	if (server_workers != 0) {
+		/* The server only returns if it fails. */
+		int const error = server_run(input, input_length + 1, (unsigned int)server_workers);
+
+		memset(input, 0, sizeof input);
+
+		return error ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+#endif
+
+	if (site_list != NULL) {
+		int const error = batch_run(site_list, input, input_length + 1, batch_shard);
+
+		memset(input, 0, sizeof input);
+		fclose(site_list);
+
+		return error ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (derivation_absorb(&derivation, input, input_length + 1) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	free(derivation.identifier);
+
+	memset(input, 0, sizeof input);
+
+	if (checkpoint_path != NULL) {
+		return checkpoint_run(checkpoint_path, &derivation) != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if (derivation_iterate(&derivation) != 0) {
+		return EXIT_FAILURE;
+	}
+
+	if (alternative_count == 0) {
+		char* const result = derivation_render(&derivation);
+
+		if (result == NULL) {
+			return EXIT_FAILURE;
+		}
+
+		puts(result);
+
+		free(result);
+		return EXIT_SUCCESS;
+	}
+
+	password_bases_free(derivation.scheme.last_base);
+
+	for (size_t i = 0; i < alternative_count; i++) {
+		struct derivation candidate = derivation;
+		candidate.scheme.last_base = alternatives[i].last_base;
+		candidate.scheme.length = alternatives[i].length;
+
+		char* const result = derivation_render(&candidate);
+
+		if (result == NULL) {
+			return EXIT_FAILURE;
+		}
+
+		printf("%s\t%s\n", alternative_specs[i], result);
+		free(result);
+		memset(&candidate.state, 0, sizeof candidate.state);
+	}
+
+	free(alternatives);
 	return EXIT_SUCCESS;
 }
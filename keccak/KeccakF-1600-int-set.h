@@ -4,3 +4,11 @@
 #define ProvideFast1088
 #define ProvideFast1152
 #define ProvideFast1344
+
+// Bit-interleaved 32-bit implementation on 32-bit x86, where it was measured to be
+// faster than the 64-bit one from i686 to current cores, unless overridden by
+// defining KeccakOpt32 or KeccakOpt64. Other 32-bit targets keep the 64-bit
+// implementation until they are measured.
+#if !defined(KeccakOpt32) && !defined(KeccakOpt64) && defined(__i386__)
+#define KeccakOpt32
+#endif
@@ -18,29 +18,32 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 void KeccakInitialize( void );
 void KeccakInitializeState(unsigned char *state);
-void KeccakPermutation(unsigned char *state);
+void KeccakPermutation(unsigned char *state, unsigned int nrRounds);
 #ifdef ProvideFast576
-void KeccakAbsorb576bits(unsigned char *state, const unsigned char *data);
+void KeccakAbsorb576bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds);
 #endif
 #ifdef ProvideFast832
-void KeccakAbsorb832bits(unsigned char *state, const unsigned char *data);
+void KeccakAbsorb832bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds);
 #endif
 #ifdef ProvideFast1024
-void KeccakAbsorb1024bits(unsigned char *state, const unsigned char *data);
+void KeccakAbsorb1024bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds);
 #endif
 #ifdef ProvideFast1088
-void KeccakAbsorb1088bits(unsigned char *state, const unsigned char *data);
+void KeccakAbsorb1088bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds);
 #endif
 #ifdef ProvideFast1152
-void KeccakAbsorb1152bits(unsigned char *state, const unsigned char *data);
+void KeccakAbsorb1152bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds);
 #endif
 #ifdef ProvideFast1344
-void KeccakAbsorb1344bits(unsigned char *state, const unsigned char *data);
+void KeccakAbsorb1344bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds);
 #endif
-void KeccakAbsorb(unsigned char *state, const unsigned char *data, unsigned int laneCount);
+void KeccakAbsorb(unsigned char *state, const unsigned char *data, unsigned int laneCount, unsigned int nrRounds);
 #ifdef ProvideFast1024
 void KeccakExtract1024bits(const unsigned char *state, unsigned char *data);
 #endif
 void KeccakExtract(const unsigned char *state, unsigned char *data, unsigned int laneCount);
+// XOR bytes into, or extract bytes from, the state at any byte offset within the first 200 bytes
+void KeccakXorBytesIntoState(unsigned char *state, const unsigned char *data, unsigned int offset, unsigned int length);
+void KeccakExtractBytes(const unsigned char *state, unsigned char *data, unsigned int offset, unsigned int length);
 
 #endif
@@ -0,0 +1,237 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include <string.h>
+#include "KeccakF-1600-interface.h"
+
+#ifdef KeccakOpt32
+
+// Each 64-bit lane is stored bit-interleaved as two 32-bit words, the even bits
+// first and the odd bits second, so that 64-bit rotations become 32-bit ones.
+
+typedef unsigned char UINT8;
+typedef unsigned int UINT32;
+
+#define ROL32(a, offset) ((((UINT32)a) << (offset)) | (((UINT32)a) >> ((32-(offset)) & 31)))
+
+const UINT32 KeccakF1600RoundConstantsInterleaved[48] = {
+    0x00000001, 0x00000000,
+    0x00000000, 0x00000089,
+    0x00000000, 0x8000008B,
+    0x00000000, 0x80008080,
+    0x00000001, 0x0000008B,
+    0x00000001, 0x00008000,
+    0x00000001, 0x80008088,
+    0x00000001, 0x80000082,
+    0x00000000, 0x0000000B,
+    0x00000000, 0x0000000A,
+    0x00000001, 0x00008082,
+    0x00000000, 0x00008003,
+    0x00000001, 0x0000808B,
+    0x00000001, 0x8000000B,
+    0x00000001, 0x8000008A,
+    0x00000001, 0x80000081,
+    0x00000000, 0x80000081,
+    0x00000000, 0x80000008,
+    0x00000000, 0x00000083,
+    0x00000000, 0x80008003,
+    0x00000001, 0x80008088,
+    0x00000000, 0x80000088,
+    0x00000001, 0x00008000,
+    0x00000000, 0x80008082 };
+
+#include "KeccakF-1600-32BI-inplace.macros"
+
+// The number of rounds must be a multiple of four
+void KeccakPermutationOnWords(UINT32 *state, unsigned int nrRounds)
+{
+    UINT32 Ca0, Ca1, Ce0, Ce1, Ci0, Ci1, Co0, Co1, Cu0, Cu1;
+    UINT32 Da0, Da1, De0, De1, Di0, Di1, Do0, Do1, Du0, Du1;
+    UINT32 Ba, Be, Bi, Bo, Bu;
+    const UINT32 *pRoundConstants = KeccakF1600RoundConstantsInterleaved + 2*(24-nrRounds);
+
+    for( ; nrRounds != 0; nrRounds -= 4) {
+        KeccakRound0()
+        KeccakRound1()
+        KeccakRound2()
+        KeccakRound3()
+    }
+}
+
+void KeccakInitialize()
+{
+}
+
+void KeccakInitializeState(unsigned char *state)
+{
+    memset(state, 0, 200);
+}
+
+void KeccakPermutation(unsigned char *state, unsigned int nrRounds)
+{
+    KeccakPermutationOnWords((UINT32*)state, nrRounds);
+}
+
+// Separate the even and odd bits of a 32-bit word into its low and high halves
+#define unshuffle32(x, t) \
+    t = (x ^ (x >> 1)) & 0x22222222; x ^= t ^ (t << 1); \
+    t = (x ^ (x >> 2)) & 0x0C0C0C0C; x ^= t ^ (t << 2); \
+    t = (x ^ (x >> 4)) & 0x00F000F0; x ^= t ^ (t << 4); \
+    t = (x ^ (x >> 8)) & 0x0000FF00; x ^= t ^ (t << 8);
+
+// The inverse of unshuffle32
+#define shuffle32(x, t) \
+    t = (x ^ (x >> 8)) & 0x0000FF00; x ^= t ^ (t << 8); \
+    t = (x ^ (x >> 4)) & 0x00F000F0; x ^= t ^ (t << 4); \
+    t = (x ^ (x >> 2)) & 0x0C0C0C0C; x ^= t ^ (t << 2); \
+    t = (x ^ (x >> 1)) & 0x22222222; x ^= t ^ (t << 1);
+
+void xorLanesIntoState(UINT32 *state, const UINT8 *data, unsigned int laneCount)
+{
+    unsigned int i;
+    UINT32 low, high, t;
+
+    for(i=0; i<laneCount; i++, data+=8) {
+        low  = (UINT32)data[0] | ((UINT32)data[1] << 8) | ((UINT32)data[2] << 16) | ((UINT32)data[3] << 24);
+        high = (UINT32)data[4] | ((UINT32)data[5] << 8) | ((UINT32)data[6] << 16) | ((UINT32)data[7] << 24);
+        unshuffle32(low, t)
+        unshuffle32(high, t)
+        state[2*i  ] ^= (low & 0x0000FFFF) | (high << 16);
+        state[2*i+1] ^= (low >> 16) | (high & 0xFFFF0000);
+    }
+}
+
+void KeccakAbsorb(unsigned char *state, const unsigned char *data, unsigned int laneCount, unsigned int nrRounds)
+{
+    xorLanesIntoState((UINT32*)state, data, laneCount);
+    KeccakPermutationOnWords((UINT32*)state, nrRounds);
+}
+
+#ifdef ProvideFast576
+void KeccakAbsorb576bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
+{
+    KeccakAbsorb(state, data, 9, nrRounds);
+}
+#endif
+
+#ifdef ProvideFast832
+void KeccakAbsorb832bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
+{
+    KeccakAbsorb(state, data, 13, nrRounds);
+}
+#endif
+
+#ifdef ProvideFast1024
+void KeccakAbsorb1024bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
+{
+    KeccakAbsorb(state, data, 16, nrRounds);
+}
+#endif
+
+#ifdef ProvideFast1088
+void KeccakAbsorb1088bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
+{
+    KeccakAbsorb(state, data, 17, nrRounds);
+}
+#endif
+
+#ifdef ProvideFast1152
+void KeccakAbsorb1152bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
+{
+    KeccakAbsorb(state, data, 18, nrRounds);
+}
+#endif
+
+#ifdef ProvideFast1344
+void KeccakAbsorb1344bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
+{
+    KeccakAbsorb(state, data, 21, nrRounds);
+}
+#endif
+
+void KeccakExtract(const unsigned char *state, unsigned char *data, unsigned int laneCount)
+{
+    const UINT32 *words = (const UINT32*)state;
+    unsigned int i, j;
+    UINT32 low, high, t;
+
+    for(i=0; i<laneCount; i++, data+=8) {
+        low  = (words[2*i] & 0x0000FFFF) | (words[2*i+1] << 16);
+        high = (words[2*i] >> 16) | (words[2*i+1] & 0xFFFF0000);
+        shuffle32(low, t)
+        shuffle32(high, t)
+        for(j=0; j<4; j++) {
+            data[j  ] = (UINT8)(low >> (8*j));
+            data[j+4] = (UINT8)(high >> (8*j));
+        }
+    }
+}
+
+#ifdef ProvideFast1024
+void KeccakExtract1024bits(const unsigned char *state, unsigned char *data)
+{
+    KeccakExtract(state, data, 16);
+}
+#endif
+
+void KeccakXorBytesIntoState(unsigned char *state, const unsigned char *data, unsigned int offset, unsigned int length)
+{
+    UINT8 lane[8];
+    unsigned int laneOffset, chunk;
+
+    // Interleaving is linear, so a partial lane is XORed as a whole lane padded with zeroes
+    while(length > 0) {
+        laneOffset = offset%8;
+        if ((laneOffset == 0) && (length >= 8)) {
+            chunk = length - length%8;
+            xorLanesIntoState((UINT32*)state + 2*(offset/8), data, chunk/8);
+        }
+        else {
+            chunk = 8 - laneOffset;
+            if (chunk > length)
+                chunk = length;
+            memset(lane, 0, 8);
+            memcpy(lane + laneOffset, data, chunk);
+            xorLanesIntoState((UINT32*)state + 2*(offset/8), lane, 1);
+        }
+        data += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+}
+
+void KeccakExtractBytes(const unsigned char *state, unsigned char *data, unsigned int offset, unsigned int length)
+{
+    UINT8 lane[8];
+    unsigned int laneOffset, chunk;
+
+    while(length > 0) {
+        laneOffset = offset%8;
+        if ((laneOffset == 0) && (length >= 8)) {
+            chunk = length - length%8;
+            KeccakExtract(state + offset, data, chunk/8);
+        }
+        else {
+            chunk = 8 - laneOffset;
+            if (chunk > length)
+                chunk = length;
+            KeccakExtract(state + offset - laneOffset, lane, 1);
+            memcpy(data, lane + laneOffset, chunk);
+        }
+        data += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+}
+
+#endif
@@ -1,4 +1,6 @@
+#ifndef Unrolling
 #define Unrolling 24
+#endif
 #define UseBebigokimisa
 //#define UseSSE
 //#define UseOnlySIMD64
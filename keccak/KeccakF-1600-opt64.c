@@ -16,6 +16,8 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #include "KeccakF-1600-opt64-settings.h"
 #include "KeccakF-1600-interface.h"
 
+#ifndef KeccakOpt32
+
 typedef unsigned char UINT8;
 typedef unsigned long long int UINT64;
 
@@ -174,7 +176,7 @@ ALIGN const UINT64 rot_39_41[2] = {39, 41};
 
 #include "KeccakF-1600-unrolling.macros"
 
-void KeccakPermutationOnWords(UINT64 *state)
+void KeccakPermutationOnWords(UINT64 *state, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -182,13 +184,13 @@ void KeccakPermutationOnWords(UINT64 *state)
 #endif
 
     copyFromState(A, state)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
 }
 
-void KeccakPermutationOnWordsAfterXoring(UINT64 *state, const UINT64 *input, unsigned int laneCount)
+void KeccakPermutationOnWordsAfterXoring(UINT64 *state, const UINT64 *input, unsigned int laneCount, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -199,14 +201,14 @@ void KeccakPermutationOnWordsAfterXoring(UINT64 *state, const UINT64 *input, uns
     for(j=0; j<laneCount; j++)
         state[j] ^= input[j];	
     copyFromState(A, state)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
 }
 
 #ifdef ProvideFast576
-void KeccakPermutationOnWordsAfterXoring576bits(UINT64 *state, const UINT64 *input)
+void KeccakPermutationOnWordsAfterXoring576bits(UINT64 *state, const UINT64 *input, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -214,7 +216,7 @@ void KeccakPermutationOnWordsAfterXoring576bits(UINT64 *state, const UINT64 *inp
 #endif
 
     copyFromStateAndXor576bits(A, state, input)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
@@ -222,7 +224,7 @@ void KeccakPermutationOnWordsAfterXoring576bits(UINT64 *state, const UINT64 *inp
 #endif
 
 #ifdef ProvideFast832
-void KeccakPermutationOnWordsAfterXoring832bits(UINT64 *state, const UINT64 *input)
+void KeccakPermutationOnWordsAfterXoring832bits(UINT64 *state, const UINT64 *input, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -230,7 +232,7 @@ void KeccakPermutationOnWordsAfterXoring832bits(UINT64 *state, const UINT64 *inp
 #endif
 
     copyFromStateAndXor832bits(A, state, input)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
@@ -238,7 +240,7 @@ void KeccakPermutationOnWordsAfterXoring832bits(UINT64 *state, const UINT64 *inp
 #endif
 
 #ifdef ProvideFast1024
-void KeccakPermutationOnWordsAfterXoring1024bits(UINT64 *state, const UINT64 *input)
+void KeccakPermutationOnWordsAfterXoring1024bits(UINT64 *state, const UINT64 *input, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -246,7 +248,7 @@ void KeccakPermutationOnWordsAfterXoring1024bits(UINT64 *state, const UINT64 *in
 #endif
 
     copyFromStateAndXor1024bits(A, state, input)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
@@ -254,7 +256,7 @@ void KeccakPermutationOnWordsAfterXoring1024bits(UINT64 *state, const UINT64 *in
 #endif
 
 #ifdef ProvideFast1088
-void KeccakPermutationOnWordsAfterXoring1088bits(UINT64 *state, const UINT64 *input)
+void KeccakPermutationOnWordsAfterXoring1088bits(UINT64 *state, const UINT64 *input, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -262,7 +264,7 @@ void KeccakPermutationOnWordsAfterXoring1088bits(UINT64 *state, const UINT64 *in
 #endif
 
     copyFromStateAndXor1088bits(A, state, input)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
@@ -270,7 +272,7 @@ void KeccakPermutationOnWordsAfterXoring1088bits(UINT64 *state, const UINT64 *in
 #endif
 
 #ifdef ProvideFast1152
-void KeccakPermutationOnWordsAfterXoring1152bits(UINT64 *state, const UINT64 *input)
+void KeccakPermutationOnWordsAfterXoring1152bits(UINT64 *state, const UINT64 *input, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -278,7 +280,7 @@ void KeccakPermutationOnWordsAfterXoring1152bits(UINT64 *state, const UINT64 *in
 #endif
 
     copyFromStateAndXor1152bits(A, state, input)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
@@ -286,7 +288,7 @@ void KeccakPermutationOnWordsAfterXoring1152bits(UINT64 *state, const UINT64 *in
 #endif
 
 #ifdef ProvideFast1344
-void KeccakPermutationOnWordsAfterXoring1344bits(UINT64 *state, const UINT64 *input)
+void KeccakPermutationOnWordsAfterXoring1344bits(UINT64 *state, const UINT64 *input, unsigned int nrRounds)
 {
     declareABCDE
 #if (Unrolling != 24)
@@ -294,7 +296,7 @@ void KeccakPermutationOnWordsAfterXoring1344bits(UINT64 *state, const UINT64 *in
 #endif
 
     copyFromStateAndXor1344bits(A, state, input)
-    rounds
+    roundsFor(nrRounds)
 #if defined(UseMMX)
     _mm_empty();
 #endif
@@ -318,10 +320,10 @@ void KeccakInitializeState(unsigned char *state)
 #endif
 }
 
-void KeccakPermutation(unsigned char *state)
+void KeccakPermutation(unsigned char *state, unsigned int nrRounds)
 {
     // We assume the state is always stored as words
-    KeccakPermutationOnWords((UINT64*)state);
+    KeccakPermutationOnWords((UINT64*)state, nrRounds);
 }
 
 void fromBytesToWord(UINT64 *word, const UINT8 *bytes)
@@ -334,112 +336,112 @@ void fromBytesToWord(UINT64 *word, const UINT8 *bytes)
 }
 
 #ifdef ProvideFast576
-void KeccakAbsorb576bits(unsigned char *state, const unsigned char *data)
+void KeccakAbsorb576bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring576bits((UINT64*)state, (const UINT64*)data);
+    KeccakPermutationOnWordsAfterXoring576bits((UINT64*)state, (const UINT64*)data, nrRounds);
 #else
     UINT64 dataAsWords[9];
     unsigned int i;
 
     for(i=0; i<9; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring576bits((UINT64*)state, dataAsWords);
+    KeccakPermutationOnWordsAfterXoring576bits((UINT64*)state, dataAsWords, nrRounds);
 #endif
 }
 #endif
 
 #ifdef ProvideFast832
-void KeccakAbsorb832bits(unsigned char *state, const unsigned char *data)
+void KeccakAbsorb832bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring832bits((UINT64*)state, (const UINT64*)data);
+    KeccakPermutationOnWordsAfterXoring832bits((UINT64*)state, (const UINT64*)data, nrRounds);
 #else
     UINT64 dataAsWords[13];
     unsigned int i;
 
     for(i=0; i<13; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring832bits((UINT64*)state, dataAsWords);
+    KeccakPermutationOnWordsAfterXoring832bits((UINT64*)state, dataAsWords, nrRounds);
 #endif
 }
 #endif
 
 #ifdef ProvideFast1024
-void KeccakAbsorb1024bits(unsigned char *state, const unsigned char *data)
+void KeccakAbsorb1024bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring1024bits((UINT64*)state, (const UINT64*)data);
+    KeccakPermutationOnWordsAfterXoring1024bits((UINT64*)state, (const UINT64*)data, nrRounds);
 #else
     UINT64 dataAsWords[16];
     unsigned int i;
 
     for(i=0; i<16; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring1024bits((UINT64*)state, dataAsWords);
+    KeccakPermutationOnWordsAfterXoring1024bits((UINT64*)state, dataAsWords, nrRounds);
 #endif
 }
 #endif
 
 #ifdef ProvideFast1088
-void KeccakAbsorb1088bits(unsigned char *state, const unsigned char *data)
+void KeccakAbsorb1088bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring1088bits((UINT64*)state, (const UINT64*)data);
+    KeccakPermutationOnWordsAfterXoring1088bits((UINT64*)state, (const UINT64*)data, nrRounds);
 #else
     UINT64 dataAsWords[17];
     unsigned int i;
 
     for(i=0; i<17; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring1088bits((UINT64*)state, dataAsWords);
+    KeccakPermutationOnWordsAfterXoring1088bits((UINT64*)state, dataAsWords, nrRounds);
 #endif
 }
 #endif
 
 #ifdef ProvideFast1152
-void KeccakAbsorb1152bits(unsigned char *state, const unsigned char *data)
+void KeccakAbsorb1152bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring1152bits((UINT64*)state, (const UINT64*)data);
+    KeccakPermutationOnWordsAfterXoring1152bits((UINT64*)state, (const UINT64*)data, nrRounds);
 #else
     UINT64 dataAsWords[18];
     unsigned int i;
 
     for(i=0; i<18; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring1152bits((UINT64*)state, dataAsWords);
+    KeccakPermutationOnWordsAfterXoring1152bits((UINT64*)state, dataAsWords, nrRounds);
 #endif
 }
 #endif
 
 #ifdef ProvideFast1344
-void KeccakAbsorb1344bits(unsigned char *state, const unsigned char *data)
+void KeccakAbsorb1344bits(unsigned char *state, const unsigned char *data, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring1344bits((UINT64*)state, (const UINT64*)data);
+    KeccakPermutationOnWordsAfterXoring1344bits((UINT64*)state, (const UINT64*)data, nrRounds);
 #else
     UINT64 dataAsWords[21];
     unsigned int i;
 
     for(i=0; i<21; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring1344bits((UINT64*)state, dataAsWords);
+    KeccakPermutationOnWordsAfterXoring1344bits((UINT64*)state, dataAsWords, nrRounds);
 #endif
 }
 #endif
 
-void KeccakAbsorb(unsigned char *state, const unsigned char *data, unsigned int laneCount)
+void KeccakAbsorb(unsigned char *state, const unsigned char *data, unsigned int laneCount, unsigned int nrRounds)
 {
 #if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
-    KeccakPermutationOnWordsAfterXoring((UINT64*)state, (const UINT64*)data, laneCount);
+    KeccakPermutationOnWordsAfterXoring((UINT64*)state, (const UINT64*)data, laneCount, nrRounds);
 #else
     UINT64 dataAsWords[25];
     unsigned int i;
 
     for(i=0; i<laneCount; i++)
         fromBytesToWord(dataAsWords+i, data+(i*8));
-    KeccakPermutationOnWordsAfterXoring((UINT64*)state, dataAsWords, laneCount);
+    KeccakPermutationOnWordsAfterXoring((UINT64*)state, dataAsWords, laneCount, nrRounds);
 #endif
 }
 
@@ -502,3 +504,60 @@ void KeccakExtract(const unsigned char *state, unsigned char *data, unsigned int
     }
 #endif
 }
+
+void KeccakXorBytesIntoState(unsigned char *state, const unsigned char *data, unsigned int offset, unsigned int length)
+{
+    // XOR commutes with the lane complementing, so the complemented lanes need no special care here
+#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
+    UINT64 lane;
+
+    for(; (length > 0) && ((offset % 8) != 0); offset++, data++, length--)
+        state[offset] ^= *data;
+    for(; length >= 8; offset += 8, data += 8, length -= 8) {
+        memcpy(&lane, data, 8);
+        ((UINT64*)state)[offset/8] ^= lane;
+    }
+    for(; length > 0; offset++, data++, length--)
+        state[offset] ^= *data;
+#else
+    unsigned int i;
+
+    for(i=0; i<length; i++)
+        ((UINT64*)state)[(offset+i)/8] ^= (UINT64)data[i] << (8*((offset+i)%8));
+#endif
+}
+
+#ifdef UseBebigokimisa
+static const unsigned int complementedLanes[6] = { 1, 2, 8, 12, 17, 20 };
+#endif
+
+void KeccakExtractBytes(const unsigned char *state, unsigned char *data, unsigned int offset, unsigned int length)
+{
+    unsigned int i;
+#ifdef UseBebigokimisa
+    unsigned int k, begin, end;
+#endif
+
+#if (PLATFORM_BYTE_ORDER == IS_LITTLE_ENDIAN)
+    memcpy(data, state+offset, length);
+#else
+    for(i=0; i<length; i++)
+        data[i] = (UINT8)(((const UINT64*)state)[(offset+i)/8] >> (8*((offset+i)%8)));
+#endif
+#ifdef UseBebigokimisa
+    for(k=0; k<6; k++) {
+        begin = complementedLanes[k]*8;
+        end = begin+8;
+        if (begin < offset)
+            begin = offset;
+        if (end > offset+length)
+            end = offset+length;
+        for(i=begin; i<end; i++)
+            data[i-offset] = ~data[i-offset];
+    }
+#else
+    (void)i;
+#endif
+}
+
+#endif
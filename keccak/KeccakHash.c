@@ -0,0 +1,196 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#include "KeccakHash.h"
+#include "KeccakF-1600-interface.h"
+
+// The rate is always a constant at the call sites below, so the dispatch to the
+// specialised entry points is resolved at compile time.
+
+static inline void HashAbsorbBlock(unsigned char *state, const unsigned char *data, unsigned int rate)
+{
+#ifdef ProvideFast576
+    if (rate == 576)
+        KeccakAbsorb576bits(state, data, 24);
+    else
+#endif
+#ifdef ProvideFast1088
+    if (rate == 1088)
+        KeccakAbsorb1088bits(state, data, 24);
+    else
+#endif
+#ifdef ProvideFast1344
+    if (rate == 1344)
+        KeccakAbsorb1344bits(state, data, 24);
+    else
+#endif
+        KeccakAbsorb(state, data, rate/64, 24);
+}
+
+static inline void HashInit(KeccakHashState *instance)
+{
+    KeccakInitialize();
+    KeccakInitializeState(instance->state);
+    instance->byteIOIndex = 0;
+    instance->squeezing = 0;
+}
+
+static inline int HashUpdate(KeccakHashState *instance, const unsigned char *data, size_t length, unsigned int rate)
+{
+    const unsigned int rateInBytes = rate/8;
+    unsigned int partialBlock;
+
+    if (instance->squeezing)
+        return 1; // Too late for additional input
+
+    if (instance->byteIOIndex > 0) {
+        partialBlock = rateInBytes - instance->byteIOIndex;
+        if (partialBlock > length)
+            partialBlock = (unsigned int)length;
+        KeccakXorBytesIntoState(instance->state, data, instance->byteIOIndex, partialBlock);
+        instance->byteIOIndex += partialBlock;
+        data += partialBlock;
+        length -= partialBlock;
+        if (instance->byteIOIndex < rateInBytes)
+            return 0;
+        KeccakPermutation(instance->state, 24);
+        instance->byteIOIndex = 0;
+    }
+    for(; length >= rateInBytes; data += rateInBytes, length -= rateInBytes)
+        HashAbsorbBlock(instance->state, data, rate);
+    KeccakXorBytesIntoState(instance->state, data, 0, (unsigned int)length);
+    instance->byteIOIndex = (unsigned int)length;
+    return 0;
+}
+
+static inline void HashPadAndSwitchToSqueezingPhase(KeccakHashState *instance, unsigned int rate, unsigned char delimitedSuffix)
+{
+    const unsigned char lastBit = 0x80;
+
+    KeccakXorBytesIntoState(instance->state, &delimitedSuffix, instance->byteIOIndex, 1);
+    KeccakXorBytesIntoState(instance->state, &lastBit, rate/8 - 1, 1);
+    KeccakPermutation(instance->state, 24);
+    instance->byteIOIndex = 0;
+    instance->squeezing = 1;
+}
+
+static inline void HashSqueeze(KeccakHashState *instance, unsigned char *output, size_t length, unsigned int rate, unsigned char delimitedSuffix)
+{
+    const unsigned int rateInBytes = rate/8;
+    size_t partialBlock;
+
+    if (!instance->squeezing)
+        HashPadAndSwitchToSqueezingPhase(instance, rate, delimitedSuffix);
+    while(length > 0) {
+        if (instance->byteIOIndex == rateInBytes) {
+            KeccakPermutation(instance->state, 24);
+            instance->byteIOIndex = 0;
+        }
+        partialBlock = rateInBytes - instance->byteIOIndex;
+        if (partialBlock > length)
+            partialBlock = length;
+        KeccakExtractBytes(instance->state, output, instance->byteIOIndex, (unsigned int)partialBlock);
+        instance->byteIOIndex += (unsigned int)partialBlock;
+        output += partialBlock;
+        length -= partialBlock;
+    }
+}
+
+static inline int HashFinal(KeccakHashState *instance, unsigned char *digest, size_t digestLength, unsigned int rate)
+{
+    if (instance->squeezing)
+        return 1;
+    HashSqueeze(instance, digest, digestLength, rate, 0x06);
+    return 0;
+}
+
+void SHA3_256_Init(KeccakHashState *instance) { HashInit(instance); }
+void SHA3_512_Init(KeccakHashState *instance) { HashInit(instance); }
+void SHAKE128_Init(KeccakHashState *instance) { HashInit(instance); }
+void SHAKE256_Init(KeccakHashState *instance) { HashInit(instance); }
+
+int SHA3_256_Update(KeccakHashState *instance, const unsigned char *data, size_t length)
+{
+    return HashUpdate(instance, data, length, 1088);
+}
+
+int SHA3_512_Update(KeccakHashState *instance, const unsigned char *data, size_t length)
+{
+    return HashUpdate(instance, data, length, 576);
+}
+
+int SHAKE128_Update(KeccakHashState *instance, const unsigned char *data, size_t length)
+{
+    return HashUpdate(instance, data, length, 1344);
+}
+
+int SHAKE256_Update(KeccakHashState *instance, const unsigned char *data, size_t length)
+{
+    return HashUpdate(instance, data, length, 1088);
+}
+
+int SHA3_256_Final(KeccakHashState *instance, unsigned char *digest)
+{
+    return HashFinal(instance, digest, 32, 1088);
+}
+
+int SHA3_512_Final(KeccakHashState *instance, unsigned char *digest)
+{
+    return HashFinal(instance, digest, 64, 576);
+}
+
+void SHAKE128_Squeeze(KeccakHashState *instance, unsigned char *output, size_t length)
+{
+    HashSqueeze(instance, output, length, 1344, 0x1F);
+}
+
+void SHAKE256_Squeeze(KeccakHashState *instance, unsigned char *output, size_t length)
+{
+    HashSqueeze(instance, output, length, 1088, 0x1F);
+}
+
+void SHA3_256(const unsigned char *data, size_t length, unsigned char *digest)
+{
+    KeccakHashState instance;
+
+    HashInit(&instance);
+    HashUpdate(&instance, data, length, 1088);
+    HashSqueeze(&instance, digest, 32, 1088, 0x06);
+}
+
+void SHA3_512(const unsigned char *data, size_t length, unsigned char *digest)
+{
+    KeccakHashState instance;
+
+    HashInit(&instance);
+    HashUpdate(&instance, data, length, 576);
+    HashSqueeze(&instance, digest, 64, 576, 0x06);
+}
+
+void SHAKE128(const unsigned char *data, size_t length, unsigned char *output, size_t outputLength)
+{
+    KeccakHashState instance;
+
+    HashInit(&instance);
+    HashUpdate(&instance, data, length, 1344);
+    HashSqueeze(&instance, output, outputLength, 1344, 0x1F);
+}
+
+void SHAKE256(const unsigned char *data, size_t length, unsigned char *output, size_t outputLength)
+{
+    KeccakHashState instance;
+
+    HashInit(&instance);
+    HashUpdate(&instance, data, length, 1088);
+    HashSqueeze(&instance, output, outputLength, 1088, 0x1F);
+}
@@ -0,0 +1,77 @@
+/*
+The Keccak sponge function, designed by Guido Bertoni, Joan Daemen,
+Michaël Peeters and Gilles Van Assche. For more information, feedback or
+questions, please refer to our website: http://keccak.noekeon.org/
+
+Implementation by the designers,
+hereby denoted as "the implementer".
+
+To the extent possible under law, the implementer has waived all copyright
+and related or neighboring rights to the source code in this file.
+http://creativecommons.org/publicdomain/zero/1.0/
+*/
+
+#ifndef _KeccakHash_h_
+#define _KeccakHash_h_
+
+#include <stddef.h>
+#include "KeccakSponge.h"
+
+/**
+  * The state of an incremental SHA3-256, SHA3-512, SHAKE128 or SHAKE256
+  * computation (FIPS 202), which works on bytes rather than bits.
+  * Each instance must only be used with the functions of the function
+  * it was initialized for.
+  */
+ALIGN typedef struct KeccakHashStateStruct {
+    ALIGN unsigned char state[KeccakPermutationSizeInBytes];
+    unsigned int byteIOIndex;
+    int squeezing;
+} KeccakHashState;
+
+/**
+  * Functions to initialize the state of a hash function or extendable-output function.
+  * @param  instance    Pointer to the state to be initialized.
+  */
+void SHA3_256_Init(KeccakHashState *instance);
+void SHA3_512_Init(KeccakHashState *instance);
+void SHAKE128_Init(KeccakHashState *instance);
+void SHAKE256_Init(KeccakHashState *instance);
+/**
+  * Functions to give input data to be absorbed.
+  * @param  instance    Pointer to the state initialized by the matching _Init() function.
+  * @param  data        Pointer to the input data.
+  * @param  length      The number of input bytes.
+  * @pre    The final output must not have been requested yet.
+  * @return Zero if successful, 1 otherwise.
+  */
+int SHA3_256_Update(KeccakHashState *instance, const unsigned char *data, size_t length);
+int SHA3_512_Update(KeccakHashState *instance, const unsigned char *data, size_t length);
+int SHAKE128_Update(KeccakHashState *instance, const unsigned char *data, size_t length);
+int SHAKE256_Update(KeccakHashState *instance, const unsigned char *data, size_t length);
+/**
+  * Functions to pad the input and write the digest of a hash function.
+  * @param  instance    Pointer to the state initialized by the matching _Init() function.
+  * @param  digest      Pointer to the buffer for the 32- or 64-byte digest.
+  * @return Zero if successful, 1 otherwise.
+  */
+int SHA3_256_Final(KeccakHashState *instance, unsigned char *digest);
+int SHA3_512_Final(KeccakHashState *instance, unsigned char *digest);
+/**
+  * Functions to squeeze output from an extendable-output function.
+  * The first call pads the input; later calls continue the output stream.
+  * @param  instance    Pointer to the state initialized by the matching _Init() function.
+  * @param  output      Pointer to the buffer for the output.
+  * @param  length      The number of output bytes desired.
+  */
+void SHAKE128_Squeeze(KeccakHashState *instance, unsigned char *output, size_t length);
+void SHAKE256_Squeeze(KeccakHashState *instance, unsigned char *output, size_t length);
+/**
+  * One-shot functions computing the digest of, or output from, a whole input.
+  */
+void SHA3_256(const unsigned char *data, size_t length, unsigned char *digest);
+void SHA3_512(const unsigned char *data, size_t length, unsigned char *digest);
+void SHAKE128(const unsigned char *data, size_t length, unsigned char *output, size_t outputLength);
+void SHAKE256(const unsigned char *data, size_t length, unsigned char *output, size_t outputLength);
+
+#endif
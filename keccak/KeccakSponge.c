@@ -11,7 +11,6 @@ and related or neighboring rights to the source code in this file.
 http://creativecommons.org/publicdomain/zero/1.0/
 */
 
-#include <string.h>
 #include "KeccakSponge.h"
 #include "KeccakF-1600-interface.h"
 #ifdef KeccakReference
@@ -20,6 +19,13 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 int InitSponge(spongeState *state, unsigned int rate, unsigned int capacity)
 {
+    return InitSpongeRounds(state, rate, capacity, 24);
+}
+
+int InitSpongeRounds(spongeState *state, unsigned int rate, unsigned int capacity, unsigned int nrRounds)
+{
+    if ((nrRounds != 12) && (nrRounds != 24))
+        return 1;
     if (rate+capacity != 1600)
         return 1;
     if ((rate <= 0) || (rate >= 1600) || ((rate % 64) != 0))
@@ -27,9 +33,9 @@ int InitSponge(spongeState *state, unsigned int rate, unsigned int capacity)
     KeccakInitialize();
     state->rate = rate;
     state->capacity = capacity;
+    state->nrRounds = nrRounds;
     state->fixedOutputLength = 0;
     KeccakInitializeState(state->state);
-    memset(state->dataQueue, 0, KeccakMaximumRateInBytes);
     state->bitsInQueue = 0;
     state->squeezing = 0;
     state->bitsAvailableForSqueezing = 0;
@@ -37,46 +43,6 @@ int InitSponge(spongeState *state, unsigned int rate, unsigned int capacity)
     return 0;
 }
 
-void AbsorbQueue(spongeState *state)
-{
-    // state->bitsInQueue is assumed to be equal to state->rate
-    #ifdef KeccakReference
-    displayBytes(1, "Block to be absorbed", state->dataQueue, state->rate/8);
-    #endif
-#ifdef ProvideFast576
-    if (state->rate == 576)
-        KeccakAbsorb576bits(state->state, state->dataQueue);
-    else 
-#endif
-#ifdef ProvideFast832
-    if (state->rate == 832)
-        KeccakAbsorb832bits(state->state, state->dataQueue);
-    else 
-#endif
-#ifdef ProvideFast1024
-    if (state->rate == 1024)
-        KeccakAbsorb1024bits(state->state, state->dataQueue);
-    else 
-#endif
-#ifdef ProvideFast1088
-    if (state->rate == 1088)
-        KeccakAbsorb1088bits(state->state, state->dataQueue);
-    else
-#endif
-#ifdef ProvideFast1152
-    if (state->rate == 1152)
-        KeccakAbsorb1152bits(state->state, state->dataQueue);
-    else 
-#endif
-#ifdef ProvideFast1344
-    if (state->rate == 1344)
-        KeccakAbsorb1344bits(state->state, state->dataQueue);
-    else 
-#endif
-        KeccakAbsorb(state->state, state->dataQueue, state->rate/64);
-    state->bitsInQueue = 0;
-}
-
 int Absorb(spongeState *state, const unsigned char *data, unsigned long long databitlen)
 {
     unsigned long long i, j, wholeBlocks;
@@ -99,7 +65,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb576bits(state->state, curData);
+                    KeccakAbsorb576bits(state->state, curData, state->nrRounds);
                 }
             }
             else
@@ -110,7 +76,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb832bits(state->state, curData);
+                    KeccakAbsorb832bits(state->state, curData, state->nrRounds);
                 }
             }
             else
@@ -121,7 +87,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb1024bits(state->state, curData);
+                    KeccakAbsorb1024bits(state->state, curData, state->nrRounds);
                 }
             }
             else
@@ -132,7 +98,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb1088bits(state->state, curData);
+                    KeccakAbsorb1088bits(state->state, curData, state->nrRounds);
                 }
             }
             else
@@ -143,7 +109,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb1152bits(state->state, curData);
+                    KeccakAbsorb1152bits(state->state, curData, state->nrRounds);
                 }
             }
             else
@@ -154,7 +120,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb1344bits(state->state, curData);
+                    KeccakAbsorb1344bits(state->state, curData, state->nrRounds);
                 }
             }
             else
@@ -164,7 +130,7 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                     #ifdef KeccakReference
                     displayBytes(1, "Block to be absorbed", curData, state->rate/8);
                     #endif
-                    KeccakAbsorb(state->state, curData, state->rate/64);
+                    KeccakAbsorb(state->state, curData, state->rate/64, state->nrRounds);
                 }
             }
             i += wholeBlocks*state->rate;
@@ -175,14 +141,16 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
                 partialBlock = state->rate-state->bitsInQueue;
             partialByte = partialBlock % 8;
             partialBlock -= partialByte;
-            memcpy(state->dataQueue+state->bitsInQueue/8, data+i/8, partialBlock/8);
+            KeccakXorBytesIntoState(state->state, data+i/8, state->bitsInQueue/8, partialBlock/8);
             state->bitsInQueue += partialBlock;
             i += partialBlock;
-            if (state->bitsInQueue == state->rate)
-                AbsorbQueue(state);
+            if (state->bitsInQueue == state->rate) {
+                KeccakPermutation(state->state, state->nrRounds);
+                state->bitsInQueue = 0;
+            }
             if (partialByte > 0) {
-                unsigned char mask = (1 << partialByte)-1;
-                state->dataQueue[state->bitsInQueue/8] = data[i/8] & mask;
+                unsigned char lastByte = data[i/8] & ((1 << partialByte)-1);
+                KeccakXorBytesIntoState(state->state, &lastByte, state->bitsInQueue/8, 1);
                 state->bitsInQueue += partialByte;
                 i += partialByte;
             }
@@ -191,38 +159,45 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
     return 0;
 }
 
+int AbsorbZeroes(spongeState *state, unsigned long long databitlen)
+{
+    unsigned long long total, permutations, j;
+
+    if ((databitlen % 8) != 0)
+        return 1;
+    if ((state->bitsInQueue % 8) != 0)
+        return 1;
+    if (state->squeezing)
+        return 1;
+
+    // The input is XORed into the state as it arrives, and XORing zeroes changes nothing,
+    // so every block boundary crossed is a bare permutation.
+    total = state->bitsInQueue + databitlen;
+    permutations = total/state->rate;
+    state->bitsInQueue = (unsigned int)(total % state->rate);
+    for(j=0; j<permutations; j++)
+        KeccakPermutation(state->state, state->nrRounds);
+    return 0;
+}
+
 void PadAndSwitchToSqueezingPhase(spongeState *state)
 {
+    unsigned char padding;
+
     // Note: the bits are numbered from 0=LSB to 7=MSB
-    if (state->bitsInQueue + 1 == state->rate) {
-        state->dataQueue[state->bitsInQueue/8 ] |= 1 << (state->bitsInQueue % 8);
-        AbsorbQueue(state);
-        memset(state->dataQueue, 0, state->rate/8);
-    }
-    else {
-        memset(state->dataQueue + (state->bitsInQueue+7)/8, 0, state->rate/8 - (state->bitsInQueue+7)/8);
-        state->dataQueue[state->bitsInQueue/8 ] |= 1 << (state->bitsInQueue % 8);
-    }
-    state->dataQueue[(state->rate-1)/8] |= 1 << ((state->rate-1) % 8);
-    AbsorbQueue(state);
+    padding = 1 << (state->bitsInQueue % 8);
+    KeccakXorBytesIntoState(state->state, &padding, state->bitsInQueue/8, 1);
+    if (state->bitsInQueue + 1 == state->rate)
+        KeccakPermutation(state->state, state->nrRounds);
+    padding = 1 << ((state->rate-1) % 8);
+    KeccakXorBytesIntoState(state->state, &padding, (state->rate-1)/8, 1);
+    KeccakPermutation(state->state, state->nrRounds);
+    state->bitsInQueue = 0;
 
     #ifdef KeccakReference
     displayText(1, "--- Switching to squeezing phase ---");
     #endif
-#ifdef ProvideFast1024
-    if (state->rate == 1024) {
-        KeccakExtract1024bits(state->state, state->dataQueue);
-        state->bitsAvailableForSqueezing = 1024;
-    }
-    else
-#endif
-    {
-        KeccakExtract(state->state, state->dataQueue, state->rate/64);
-        state->bitsAvailableForSqueezing = state->rate;
-    }
-    #ifdef KeccakReference
-    displayBytes(1, "Block available for squeezing", state->dataQueue, state->bitsAvailableForSqueezing/8);
-    #endif
+    state->bitsAvailableForSqueezing = state->rate;
     state->squeezing = 1;
 }
 
@@ -239,28 +214,54 @@ int Squeeze(spongeState *state, unsigned char *output, unsigned long long output
     i = 0;
     while(i < outputLength) {
         if (state->bitsAvailableForSqueezing == 0) {
-            KeccakPermutation(state->state);
-#ifdef ProvideFast1024
-            if (state->rate == 1024) {
-                KeccakExtract1024bits(state->state, state->dataQueue);
-                state->bitsAvailableForSqueezing = 1024;
-            }
-            else
-#endif
-            {
-                KeccakExtract(state->state, state->dataQueue, state->rate/64);
-                state->bitsAvailableForSqueezing = state->rate;
-            }
-            #ifdef KeccakReference
-            displayBytes(1, "Block available for squeezing", state->dataQueue, state->bitsAvailableForSqueezing/8);
-            #endif
+            KeccakPermutation(state->state, state->nrRounds);
+            state->bitsAvailableForSqueezing = state->rate;
         }
         partialBlock = state->bitsAvailableForSqueezing;
         if ((unsigned long long)partialBlock > outputLength - i)
             partialBlock = (unsigned int)(outputLength - i);
-        memcpy(output+i/8, state->dataQueue+(state->rate-state->bitsAvailableForSqueezing)/8, partialBlock/8);
+        KeccakExtractBytes(state->state, output+i/8, (state->rate-state->bitsAvailableForSqueezing)/8, partialBlock/8);
         state->bitsAvailableForSqueezing -= partialBlock;
         i += partialBlock;
     }
     return 0;
 }
+
+void SaveSponge(const spongeState *state, unsigned char *buffer)
+{
+    unsigned int position = state->squeezing ? state->bitsAvailableForSqueezing : state->bitsInQueue;
+
+    KeccakExtractBytes(state->state, buffer, 0, KeccakPermutationSizeInBytes);
+    buffer += KeccakPermutationSizeInBytes;
+    buffer[0] = (unsigned char)state->rate;
+    buffer[1] = (unsigned char)(state->rate >> 8);
+    buffer[2] = (unsigned char)state->nrRounds;
+    buffer[3] = (unsigned char)state->squeezing;
+    buffer[4] = (unsigned char)position;
+    buffer[5] = (unsigned char)(position >> 8);
+}
+
+int RestoreSponge(spongeState *state, const unsigned char *buffer)
+{
+    const unsigned char *fields = buffer + KeccakPermutationSizeInBytes;
+    unsigned int rate = fields[0] | (fields[1] << 8);
+    unsigned int position = fields[4] | (fields[5] << 8);
+
+    if (InitSpongeRounds(state, rate, 1600-rate, fields[2]) != 0)
+        return 1;
+    if (fields[3] > 1)
+        return 1;
+    if (fields[3]) {
+        if ((position > rate) || ((position % 8) != 0))
+            return 1;
+        state->squeezing = 1;
+        state->bitsAvailableForSqueezing = position;
+    }
+    else {
+        if (position >= rate)
+            return 1;
+        state->bitsInQueue = position;
+    }
+    KeccakXorBytesIntoState(state->state, buffer, 0, KeccakPermutationSizeInBytes);
+    return 0;
+}
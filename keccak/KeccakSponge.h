@@ -18,6 +18,7 @@ http://creativecommons.org/publicdomain/zero/1.0/
 #define KeccakPermutationSizeInBytes (KeccakPermutationSize/8)
 #define KeccakMaximumRate 1536
 #define KeccakMaximumRateInBytes (KeccakMaximumRate/8)
+#define KeccakSpongeSavedSize (KeccakPermutationSizeInBytes+6)
 
 #if defined(__GNUC__)
 #define ALIGN __attribute__ ((aligned(32)))
@@ -29,10 +30,10 @@ http://creativecommons.org/publicdomain/zero/1.0/
 
 ALIGN typedef struct spongeStateStruct {
     ALIGN unsigned char state[KeccakPermutationSizeInBytes];
-    ALIGN unsigned char dataQueue[KeccakMaximumRateInBytes];
     unsigned int rate;
     unsigned int capacity;
-    unsigned int bitsInQueue;
+    unsigned int nrRounds;
+    unsigned int bitsInQueue; // bits of the current block already XORed into the state
     unsigned int fixedOutputLength;
     int squeezing;
     unsigned int bitsAvailableForSqueezing;
@@ -48,6 +49,18 @@ ALIGN typedef struct spongeStateStruct {
   * @return Zero if successful, 1 otherwise.
   */
 int InitSponge(spongeState *state, unsigned int rate, unsigned int capacity);
+/**
+  * Function to initialize the state of a sponge function on the reduced-round
+  * Keccak-p[1600, nrRounds] permutation, as used by TurboSHAKE and KangarooTwelve.
+  * The sponge function is set to the absorbing phase.
+  * @param  state       Pointer to the state of the sponge function to be initialized.
+  * @param  rate        The value of the rate r.
+  * @param  capacity    The value of the capacity c.
+  * @param  nrRounds    The number of rounds, either 12 or 24 (Keccak-f[1600]).
+  * @pre    One must have r+c=1600 and the rate a multiple of 64 bits in this implementation.
+  * @return Zero if successful, 1 otherwise.
+  */
+int InitSpongeRounds(spongeState *state, unsigned int rate, unsigned int capacity, unsigned int nrRounds);
 /**
   * Function to give input data for the sponge function to absorb.
   * @param  state       Pointer to the state of the sponge function initialized by InitSponge().
@@ -61,6 +74,17 @@ int InitSponge(spongeState *state, unsigned int rate, unsigned int capacity);
   * @return Zero if successful, 1 otherwise.
   */
 int Absorb(spongeState *state, const unsigned char *data, unsigned long long databitlen);
+/**
+  * Function to make the sponge function absorb a number of zero bits.
+  * This gives the same result as calling Absorb() with a buffer of zeroes, but
+  * only runs the permutations, as XORing zeroes into the state changes nothing.
+  * @param  state       Pointer to the state of the sponge function initialized by InitSponge().
+  * @param  databitlen  The number of zero bits to absorb.
+  *                     It must be a multiple of 8.
+  * @pre    The sponge function must be in the absorbing phase.
+  * @return Zero if successful, 1 otherwise.
+  */
+int AbsorbZeroes(spongeState *state, unsigned long long databitlen);
 /**
   * Function to squeeze output data from the sponge function.
   * If the sponge function was in the absorbing phase, this function 
@@ -72,5 +96,20 @@ int Absorb(spongeState *state, const unsigned char *data, unsigned long long dat
   * @return Zero if successful, 1 otherwise.
   */
 int Squeeze(spongeState *state, unsigned char *output, unsigned long long outputLength);
+/**
+  * Function to save the state of the sponge function in a form that does not depend
+  * on the permutation implementation or on the byte order of the platform.
+  * @param  state       Pointer to the state of the sponge function initialized by InitSponge().
+  * @param  buffer      Pointer to the KeccakSpongeSavedSize bytes where to store the saved state.
+  */
+void SaveSponge(const spongeState *state, unsigned char *buffer);
+/**
+  * Function to restore the state of a sponge function saved by SaveSponge(),
+  * in the same phase and at the same position.
+  * @param  state       Pointer to the state of the sponge function to be restored.
+  * @param  buffer      Pointer to the KeccakSpongeSavedSize bytes of the saved state.
+  * @return Zero if successful, 1 if the saved state is not valid.
+  */
+int RestoreSponge(spongeState *state, const unsigned char *buffer);
 
 #endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../keccak/KeccakSponge.h"
+#include "../keccak/KeccakHash.h"
+
+/* Compares the throughput of the byte-oriented hash API with the same functions built on the
+ * generic sponge, for a large input and for many small updates. Run by `make bench`. */
+
+#define MESSAGE_SIZE (1 << 20)
+#define REPEATS 64
+#define SMALL_UPDATE 64
+
+static double now(void) {
+	struct timespec t;
+
+	timespec_get(&t, TIME_UTC);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+/* SHA3 appends the domain bits 01 and SHAKE the bits 1111 before the sponge's own padding. */
+static void generic_hash(unsigned int const rate, unsigned char const domain, unsigned int const domain_bits, unsigned char const* const message, size_t const length, size_t const update, unsigned char* const output, size_t const output_length) {
+	spongeState state;
+
+	InitSponge(&state, rate, 1600 - rate);
+
+	for (size_t i = 0; i < length; i += update) {
+		Absorb(&state, message + i, (unsigned long long)(update < length - i ? update : length - i) * 8);
+	}
+
+	Absorb(&state, &domain, domain_bits);
+	Squeeze(&state, output, (unsigned long long)output_length * 8);
+}
+
+static void api_sha3_256(unsigned char const* const message, size_t const length, size_t const update, unsigned char* const output) {
+	KeccakHashState state;
+
+	SHA3_256_Init(&state);
+
+	for (size_t i = 0; i < length; i += update) {
+		SHA3_256_Update(&state, message + i, update < length - i ? update : length - i);
+	}
+
+	SHA3_256_Final(&state, output);
+}
+
+static void api_shake128(unsigned char const* const message, size_t const length, size_t const update, unsigned char* const output) {
+	KeccakHashState state;
+
+	SHAKE128_Init(&state);
+
+	for (size_t i = 0; i < length; i += update) {
+		SHAKE128_Update(&state, message + i, update < length - i ? update : length - i);
+	}
+
+	SHAKE128_Squeeze(&state, output, 32);
+}
+
+static void report(char const* const name, double const start) {
+	printf("%-48s %8.1f MB/s\n", name, (double)MESSAGE_SIZE * REPEATS / 1e6 / (now() - start));
+}
+
+int main(void) {
+	unsigned char* const message = malloc(MESSAGE_SIZE);
+	unsigned char generic[32];
+	unsigned char api[32];
+	double start;
+
+	if (message == NULL) {
+		fputs("Failed to allocate memory.\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < MESSAGE_SIZE; i++) {
+		message[i] = (unsigned char)(i % 251);
+	}
+
+	size_t const updates[] = { MESSAGE_SIZE, SMALL_UPDATE };
+
+	for (size_t u = 0; u < sizeof updates / sizeof *updates; u++) {
+		size_t const update = updates[u];
+		char name[64];
+
+		start = now();
+		for (int r = 0; r < REPEATS; r++) {
+			generic_hash(1088, 0x02, 2, message, MESSAGE_SIZE, update, generic, sizeof generic);
+		}
+		snprintf(name, sizeof name, "SHA3-256, generic sponge, %zu-byte updates", update);
+		report(name, start);
+
+		start = now();
+		for (int r = 0; r < REPEATS; r++) {
+			api_sha3_256(message, MESSAGE_SIZE, update, api);
+		}
+		snprintf(name, sizeof name, "SHA3-256, hash API, %zu-byte updates", update);
+		report(name, start);
+
+		if (memcmp(generic, api, sizeof api) != 0) {
+			fputs("SHA3-256 outputs differ.\n", stderr);
+			free(message);
+			return EXIT_FAILURE;
+		}
+
+		start = now();
+		for (int r = 0; r < REPEATS; r++) {
+			generic_hash(1344, 0x0f, 4, message, MESSAGE_SIZE, update, generic, sizeof generic);
+		}
+		snprintf(name, sizeof name, "SHAKE128, generic sponge, %zu-byte updates", update);
+		report(name, start);
+
+		start = now();
+		for (int r = 0; r < REPEATS; r++) {
+			api_shake128(message, MESSAGE_SIZE, update, api);
+		}
+		snprintf(name, sizeof name, "SHAKE128, hash API, %zu-byte updates", update);
+		report(name, start);
+
+		if (memcmp(generic, api, sizeof api) != 0) {
+			fputs("SHAKE128 outputs differ.\n", stderr);
+			free(message);
+			return EXIT_FAILURE;
+		}
+	}
+
+	free(message);
+	return EXIT_SUCCESS;
+}
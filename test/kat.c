@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../keccak/KeccakSponge.h"
+#include "../keccak/KeccakHash.h"
+
+/* Known answers for the Keccak backend and the hash API over it, checked by `make check`. The
+ * message ptn(n) is n bytes of 00 01 ... FA repeated, as in RFC 9861. */
+
+struct turboshake_vector {
+	char const* name;
+	unsigned int rate;
+	size_t message_length;
+	size_t output_length;
+	size_t skip;
+	char const* expected;
+};
+
+static struct turboshake_vector const turboshake_vectors[] = {
+	{ "TurboSHAKE128(ptn(0), 32)", 1344, 0, 32, 0,
+		"1E415F1C5983AFF2169217277D17BB538CD945A397DDEC541F1CE41AF2C1B74C" },
+	{ "TurboSHAKE128(ptn(0), 64)", 1344, 0, 64, 0,
+		"1E415F1C5983AFF2169217277D17BB538CD945A397DDEC541F1CE41AF2C1B74C"
+		"3E8CCAE2A4DAE56C84A04C2385C03C15E8193BDF58737363321691C05462C8DF" },
+	{ "TurboSHAKE128(ptn(0), 10032), last 32", 1344, 0, 10032, 10000,
+		"A3B9B0385900CE761F22AED548E754DA10A5242D62E8C658E3F3A923A7555607" },
+	{ "TurboSHAKE128(ptn(1), 32)", 1344, 1, 32, 0,
+		"55CEDD6F60AF7BB29A4042AE832EF3F58DB7299F893EBB9247247D856958DAA9" },
+	{ "TurboSHAKE128(ptn(17), 32)", 1344, 17, 32, 0,
+		"9C97D036A3BAC819DB70EDE0CA554EC6E4C2A1A4FFBFD9EC269CA6A111161233" },
+	{ "TurboSHAKE128(ptn(17^2), 32)", 1344, 17 * 17, 32, 0,
+		"96C77C279E0126F7FC07C9B07F5CDAE1E0BE60BDBE10620040E75D7223A624D2" },
+	{ "TurboSHAKE256(ptn(0), 64)", 1088, 0, 64, 0,
+		"367A329DAFEA871C7802EC67F905AE13C57695DC2C6663C61035F59A18F8E7DB"
+		"11EDC0E12E91EA60EB6B32DF06DD7F002FBAFABB6E13EC1CC20D995547600DB0" },
+	{ "TurboSHAKE256(ptn(17), 64)", 1088, 17, 64, 0,
+		"B3BAB0300E6A191FBE6137939835923578794EA54843F5011090FA2F3780A9E5"
+		"CB22C59D78B40A0FBFF9E672C0FBE0970BD2C845091C6044D687054DA5D8E9C7" },
+};
+
+enum hash_function {
+	HASH_SHA3_256,
+	HASH_SHA3_512,
+	HASH_SHAKE128,
+	HASH_SHAKE256,
+};
+
+struct hash_vector {
+	char const* name;
+	enum hash_function function;
+	size_t message_length;
+	size_t output_length;
+	char const* expected;
+};
+
+/* From Python's hashlib, around each rate boundary. */
+static struct hash_vector const hash_vectors[] = {
+	{ "SHA3-256(ptn(0), 32)", HASH_SHA3_256, 0, 32,
+		"A7FFC6F8BF1ED76651C14756A061D662F580FF4DE43B49FA82D80A4B80F8434A" },
+	{ "SHA3-256(ptn(135), 32)", HASH_SHA3_256, 135, 32,
+		"FDED8FD9D6551C601EEB3B7C6BC5E5CFD8AAD1D015B7E9AAA9C9B9475231D5E2" },
+	{ "SHA3-256(ptn(136), 32)", HASH_SHA3_256, 136, 32,
+		"CF3CCFF92480A29160C2D38317C430E14749BFEE1788106957DFE73F8C4930E5" },
+	{ "SHA3-256(ptn(137), 32)", HASH_SHA3_256, 137, 32,
+		"CE9D7DC90913EE5D92745019479A5352C6D6279BEF18ED07DC0A83EE8084DACA" },
+	{ "SHA3-256(ptn(1000), 32)", HASH_SHA3_256, 1000, 32,
+		"48E66A01861D0EADAACDB7A6AE7DB6B9AC79242ECCED4154A9FBB33C4E3CC571" },
+	{ "SHA3-512(ptn(0), 64)", HASH_SHA3_512, 0, 64,
+		"A69F73CCA23A9AC5C8B567DC185A756E97C982164FE25859E0D1DCC1475C80A6"
+		"15B2123AF1F5F94C11E3E9402C3AC558F500199D95B6D3E301758586281DCD26" },
+	{ "SHA3-512(ptn(71), 64)", HASH_SHA3_512, 71, 64,
+		"3CCC850D53A1287AF7B4560B2EF0D43EB5D9A80D62A0E9CF1DBC040135921104"
+		"D4395168E90BFC871773EBB34BCA1BD67056E1CC7DC7A48FF7C3167D389F117C" },
+	{ "SHA3-512(ptn(72), 64)", HASH_SHA3_512, 72, 64,
+		"5D63F2BBE971A983AC6847480106E4E1264EE3A0BEFD79954914E1D86E795B2E"
+		"18238F12FC5E46CB9CC78EFDEC610A93647CC04E1C23D8CAAA6A58C21DD26C07" },
+	{ "SHA3-512(ptn(73), 64)", HASH_SHA3_512, 73, 64,
+		"921D9B7B2B0F3066A1646DBB058C979CB3925DEC0F8C269FAAA7F9648E73465A"
+		"E55EC527257D5D5E1CFDBF5D6799BEA1004B6186F5108C74E3B92FE924166558" },
+	{ "SHA3-512(ptn(1000), 64)", HASH_SHA3_512, 1000, 64,
+		"B8030D306AE990BC794BFB3A6100F67851889D6C272257AFAC7D1077A18660D6"
+		"EA8D0DA5D2299C3EBAA0D34BAF62CC58AC1FD4476506CF512A4897BB083A6FC4" },
+	{ "SHAKE128(ptn(0), 32)", HASH_SHAKE128, 0, 32,
+		"7F9C2BA4E88F827D616045507605853ED73B8093F6EFBC88EB1A6EACFA66EF26" },
+	{ "SHAKE128(ptn(167), 32)", HASH_SHAKE128, 167, 32,
+		"1E552791CC4E93A0D4A8DC47AE49228C2FAA869E40E628F6ACE477AEC3F1CA7A" },
+	{ "SHAKE128(ptn(168), 32)", HASH_SHAKE128, 168, 32,
+		"F15277EB61C4908D44A2853F3CDE071AE2ED7A23461FBE162A1A98CF6875059C" },
+	{ "SHAKE128(ptn(169), 32)", HASH_SHAKE128, 169, 32,
+		"015BE3338C986D9846AFFA0F94B4AFC2A76BC289C709E1A596EC9ECCF090A773" },
+	{ "SHAKE128(ptn(1000), 32)", HASH_SHAKE128, 1000, 32,
+		"A72440F7F5AA7C14C8E0187420611DA7E2BA62F5BB2E88A91B9C9448CAC30078" },
+	{ "SHAKE256(ptn(0), 32)", HASH_SHAKE256, 0, 32,
+		"46B9DD2B0BA88D13233B3FEB743EEB243FCD52EA62B81B82B50C27646ED5762F" },
+	{ "SHAKE256(ptn(135), 32)", HASH_SHAKE256, 135, 32,
+		"C45DAE624AD8A2F5AA7BAC9D7557737FD91C96EEDB70A6BE5574D57A844EADE0" },
+	{ "SHAKE256(ptn(136), 32)", HASH_SHAKE256, 136, 32,
+		"B7FF4073B3F5A8EABD6E17705CA7F6761A31058F9DF781A6A47E3A3063B9D67A" },
+	{ "SHAKE256(ptn(137), 32)", HASH_SHAKE256, 137, 32,
+		"01D90952C642A5EB2A8FC9D713F843A45D7AC05132DDDCB2EFC9BEBC27E37BCB" },
+	{ "SHAKE256(ptn(1000), 32)", HASH_SHAKE256, 1000, 32,
+		"34833F03ED88BB5F083CE590C7AE5AF93EDE33E11F53C70E47916C7044746ACB" },
+	{ "SHAKE128(ptn(17), 200)", HASH_SHAKE128, 17, 200,
+		"238B0259ABADBCC1F4BCE2D995BEF5DCCF87E784BFEF35CC714F0A9FAEF0D965"
+		"E30A8C9B13A4DBBF1BF1A04FCC33FFADCD451B2081E03278315654C1AAAFA835"
+		"4882C64BAE61522A6790C282DDB15F0C115B0A7CB7696F41A1D498BB29862403"
+		"A0239D4535457AAB308B7070697FA015E4387A142FC741C3000DF3B8703800D0"
+		"9074CBA8895E7E70CDE1BC4D54DD4553E335F1D00588972099618F53FF86DE69"
+		"CE4D0EBEC0C1C0E8540E403082AC1D9DE8CDAC237C55C71051F5674FAC5639F8"
+		"F9812E176A0AEF61" },
+	{ "SHAKE256(ptn(17), 200)", HASH_SHAKE256, 17, 200,
+		"160BB0184BA68AD3C5AC0BFAF1B1D5BE6A06E1E39ED853C68EDB5D8F2BD4673A"
+		"8817AFCFE589BA65870D956DFE610AB55C5888BFF3E65C0572BDD37970087AC1"
+		"309895B3AE457C6ABB7A67309D05F9A404C12E253BD85A233768C06FA44A69D4"
+		"C679D9A75ECC940F223F135E5CEB0AAA74E7FE285DEED8AEAB98EBB83125FBD4"
+		"97A53C76D54B1373D414CBC9100EBE28C35B678C65F09E79A83EDDD730E4493A"
+		"D20305EFB85B8A9C44B20F29BFD8B46287F3B9DDF715B3378FF6173076A97C46"
+		"29115579C7401CFF" },
+};
+
+static int matches(unsigned char const* const output, size_t const length, char const* const expected) {
+	char hex[3];
+
+	if (strlen(expected) != 2 * length) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		snprintf(hex, sizeof hex, "%02X", output[i]);
+
+		if (memcmp(hex, expected + 2 * i, 2) != 0) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int check(char const* const name, int const passed) {
+	if (!passed) {
+		fprintf(stderr, "FAIL %s\n", name);
+	}
+
+	return !passed;
+}
+
+/* TurboSHAKE is the sponge on Keccak-p[1600, 12] with the default domain
+ * separation byte 1F, which is four 1 bits followed by the first padding bit. */
+static int turboshake_check(struct turboshake_vector const* const vector, unsigned char const* const message) {
+	unsigned char const domain = 0x0f;
+	unsigned char* const output = malloc(vector->output_length);
+	spongeState state;
+	int passed;
+
+	if (output == NULL) {
+		return check(vector->name, 0);
+	}
+
+	passed =
+		InitSpongeRounds(&state, vector->rate, 1600 - vector->rate, 12) == 0 &&
+		Absorb(&state, message, vector->message_length * 8) == 0 &&
+		Absorb(&state, &domain, 4) == 0 &&
+		Squeeze(&state, output, vector->output_length * 8) == 0 &&
+		matches(output + vector->skip, vector->output_length - vector->skip, vector->expected);
+
+	free(output);
+	return check(vector->name, passed);
+}
+
+static void hash_one_shot(struct hash_vector const* const vector, unsigned char const* const message, unsigned char* const output) {
+	switch (vector->function) {
+	case HASH_SHA3_256:
+		SHA3_256(message, vector->message_length, output);
+		break;
+	case HASH_SHA3_512:
+		SHA3_512(message, vector->message_length, output);
+		break;
+	case HASH_SHAKE128:
+		SHAKE128(message, vector->message_length, output, vector->output_length);
+		break;
+	case HASH_SHAKE256:
+		SHAKE256(message, vector->message_length, output, vector->output_length);
+		break;
+	}
+}
+
+/* Feeds the message in uneven pieces, and squeezes SHAKE output in pieces too. */
+static int hash_incremental(struct hash_vector const* const vector, unsigned char const* const message, unsigned char* const output) {
+	KeccakHashState state;
+	int error = 0;
+
+	switch (vector->function) {
+	case HASH_SHA3_256:
+		SHA3_256_Init(&state);
+		break;
+	case HASH_SHA3_512:
+		SHA3_512_Init(&state);
+		break;
+	case HASH_SHAKE128:
+		SHAKE128_Init(&state);
+		break;
+	case HASH_SHAKE256:
+		SHAKE256_Init(&state);
+		break;
+	}
+
+	for (size_t i = 0, piece = 1; i < vector->message_length; i += piece, piece = piece % 13 + 1) {
+		size_t const length = piece < vector->message_length - i ? piece : vector->message_length - i;
+
+		switch (vector->function) {
+		case HASH_SHA3_256:
+			error |= SHA3_256_Update(&state, message + i, length);
+			break;
+		case HASH_SHA3_512:
+			error |= SHA3_512_Update(&state, message + i, length);
+			break;
+		case HASH_SHAKE128:
+			error |= SHAKE128_Update(&state, message + i, length);
+			break;
+		case HASH_SHAKE256:
+			error |= SHAKE256_Update(&state, message + i, length);
+			break;
+		}
+	}
+
+	switch (vector->function) {
+	case HASH_SHA3_256:
+		return error | SHA3_256_Final(&state, output);
+	case HASH_SHA3_512:
+		return error | SHA3_512_Final(&state, output);
+	case HASH_SHAKE128:
+	case HASH_SHAKE256:
+		for (size_t i = 0; i < vector->output_length; i += 7) {
+			size_t const length = vector->output_length - i < 7 ? vector->output_length - i : 7;
+
+			if (vector->function == HASH_SHAKE128) {
+				SHAKE128_Squeeze(&state, output + i, length);
+			} else {
+				SHAKE256_Squeeze(&state, output + i, length);
+			}
+		}
+		break;
+	}
+
+	return error;
+}
+
+static int hash_check(struct hash_vector const* const vector, unsigned char const* const message) {
+	unsigned char output[200];
+	int failures = 0;
+
+	hash_one_shot(vector, message, output);
+	failures += check(vector->name, matches(output, vector->output_length, vector->expected));
+
+	memset(output, 0, sizeof output);
+	failures += check(vector->name, hash_incremental(vector, message, output) == 0 &&
+		matches(output, vector->output_length, vector->expected));
+
+	return failures;
+}
+
+int main(void) {
+	static unsigned char message[17 * 17 * 17];
+	int failures = 0;
+
+	for (size_t i = 0; i < sizeof message; i++) {
+		message[i] = (unsigned char)(i % 251);
+	}
+
+	for (size_t i = 0; i < sizeof turboshake_vectors / sizeof *turboshake_vectors; i++) {
+		failures += turboshake_check(&turboshake_vectors[i], message);
+	}
+
+	for (size_t i = 0; i < sizeof hash_vectors / sizeof *hash_vectors; i++) {
+		failures += hash_check(&hash_vectors[i], message);
+	}
+
+	if (failures != 0) {
+		fprintf(stderr, "%d known-answer tests failed.\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	puts("All known-answer tests passed.");
+	return EXIT_SUCCESS;
+}